@@ -186,7 +186,7 @@ extern int quiet; /* be quiet(er) if 1 */
 
 /* some special database keys used for storing important info */
 #define VER_KEY "$version$" /* version key */
-#define VER_ID  "2.5.0"     /* version content */
+#define VER_ID  "2.5.1"     /* version content */
 
 /* Macros for argp option handling. */
 
@@ -0,0 +1,163 @@
+/*
+ * arena.c: resettable scratch allocators
+ *
+ * Copyright (C) 2024 Colin Watson.
+ *
+ * This file is part of man-db.
+ *
+ * man-db is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * man-db is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with man-db; if not, write to the Free Software Foundation,
+ * Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ */
+
+#ifdef HAVE_CONFIG_H
+#  include "config.h"
+#endif /* HAVE_CONFIG_H */
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "xalloc.h"
+
+#include "manconfig.h"
+
+#include "arena.h"
+
+#define ARENA_BLOCK_SIZE 8192
+
+struct arena_block {
+	struct arena_block *next;
+	size_t size;
+	max_align_t data[];
+};
+
+struct arena {
+	/* The block currently being carved up comes first. */
+	struct arena_block *blocks;
+	char *next;
+	size_t left;
+	struct arena_stats stats;
+};
+
+static struct arena_block *new_block (struct arena *arena, size_t size)
+{
+	struct arena_block *block;
+
+	if (size < ARENA_BLOCK_SIZE)
+		size = ARENA_BLOCK_SIZE;
+	block = xmalloc (offsetof (struct arena_block, data) + size);
+	block->size = size;
+	++arena->stats.blocks;
+	return block;
+}
+
+struct arena *arena_new (void)
+{
+	return XZALLOC (struct arena);
+}
+
+void *arena_alloc (struct arena *arena, size_t size)
+{
+	size_t align = _Alignof (max_align_t);
+	size_t rounded = (size + align - 1) & ~(align - 1);
+	void *ret;
+
+	if (rounded < size)
+		xalloc_die ();
+
+	if (rounded > arena->left) {
+		struct arena_block *block = new_block (arena, rounded);
+
+		if (rounded > ARENA_BLOCK_SIZE && arena->blocks) {
+			/* Keep carving up the current block, since this
+			 * one is used up by a single allocation.
+			 */
+			block->next = arena->blocks->next;
+			arena->blocks->next = block;
+			ret = block->data;
+			goto out;
+		}
+		block->next = arena->blocks;
+		arena->blocks = block;
+		arena->next = (char *) block->data;
+		arena->left = block->size;
+	}
+
+	ret = arena->next;
+	arena->next += rounded;
+	arena->left -= rounded;
+
+out:
+	++arena->stats.allocations;
+	arena->stats.bytes += size;
+	return ret;
+}
+
+char *arena_strndup (struct arena *arena, const char *s, size_t n)
+{
+	size_t len = strnlen (s, n);
+	char *ret = arena_alloc (arena, len + 1);
+
+	memcpy (ret, s, len);
+	ret[len] = '\0';
+	return ret;
+}
+
+char *arena_strdup (struct arena *arena, const char *s)
+{
+	return arena_strndup (arena, s, SIZE_MAX);
+}
+
+void arena_reset (struct arena *arena)
+{
+	struct arena_block *block, *next;
+
+	if (!arena->blocks)
+		return;
+
+	/* Keep the current block if it is of the ordinary size; a block
+	 * that only exists to hold one large allocation is not worth
+	 * keeping.
+	 */
+	for (block = arena->blocks->next; block; block = next) {
+		next = block->next;
+		free (block);
+	}
+	arena->blocks->next = NULL;
+	if (arena->blocks->size > ARENA_BLOCK_SIZE) {
+		free (arena->blocks);
+		arena->blocks = NULL;
+		arena->next = NULL;
+		arena->left = 0;
+	} else {
+		arena->next = (char *) arena->blocks->data;
+		arena->left = arena->blocks->size;
+	}
+	memset (&arena->stats, 0, sizeof arena->stats);
+}
+
+void arena_get_stats (const struct arena *arena, struct arena_stats *stats)
+{
+	*stats = arena->stats;
+}
+
+void arena_free (struct arena *arena)
+{
+	if (!arena)
+		return;
+	arena_reset (arena);
+	free (arena->blocks);
+	free (arena);
+}
@@ -0,0 +1,59 @@
+/*
+ * arena.h: interface to resettable scratch allocators
+ *
+ * Copyright (C) 2024 Colin Watson.
+ *
+ * This file is part of man-db.
+ *
+ * man-db is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * man-db is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with man-db; if not, write to the Free Software Foundation,
+ * Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ */
+
+#ifndef MAN_ARENA_H
+#define MAN_ARENA_H
+
+#include <stddef.h>
+
+/* An arena hands out memory from large blocks, and releases all of it at
+ * once when reset.  It suits temporaries whose lifetimes all end at the
+ * same point, such as those made while indexing a single page.
+ */
+struct arena;
+
+struct arena_stats {
+	/* Allocations made from the arena since it was last reset. */
+	size_t allocations;
+	/* Bytes handed out since it was last reset. */
+	size_t bytes;
+	/* New blocks that had to be obtained from malloc since it was last
+	 * reset.  Allocations that fit in a block kept from before the
+	 * last reset need none.
+	 */
+	size_t blocks;
+};
+
+struct arena *arena_new (void);
+
+/* Allocate SIZE bytes, suitably aligned for any type. */
+void *arena_alloc (struct arena *arena, size_t size);
+char *arena_strdup (struct arena *arena, const char *s);
+char *arena_strndup (struct arena *arena, const char *s, size_t n);
+
+/* Release everything allocated from ARENA, keeping one block for reuse. */
+void arena_reset (struct arena *arena);
+
+void arena_get_stats (const struct arena *arena, struct arena_stats *stats);
+void arena_free (struct arena *arena);
+
+#endif /* MAN_ARENA_H */
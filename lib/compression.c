@@ -130,6 +130,21 @@ struct compression comp_list[] = {
         comp->stem = "/usr/man/man1/foo.1";
  */
 struct compression *comp_info (const char *filename, bool want_stem)
+{
+	struct compression *comp;
+	size_t stem_len;
+
+	comp = comp_info_len (filename, &stem_len);
+	if (comp && want_stem)
+		comp->stem = xstrndup (filename, stem_len);
+	return comp;
+}
+
+/* Like comp_info (filename, false), but also store the length of the
+   filename without its compression extension in *stem_len, for callers
+   that have no need of a copy.  comp->stem is set to NULL.
+ */
+struct compression *comp_info_len (const char *filename, size_t *stem_len)
 {
 	const char *ext;
 	static struct compression hpux_comp = {PROG_GUNZIP " -S \"\"", "",
@@ -141,11 +156,8 @@ struct compression *comp_info (const char *filename, bool want_stem)
 		struct compression *comp;
 		for (comp = comp_list; comp->ext; comp++) {
 			if (strcmp (comp->ext, ext + 1) == 0) {
-				if (want_stem)
-					comp->stem = xstrndup (filename,
-					                       ext - filename);
-				else
-					comp->stem = NULL;
+				comp->stem = NULL;
+				*stem_len = ext - filename;
 				return comp;
 			}
 		}
@@ -154,11 +166,8 @@ struct compression *comp_info (const char *filename, bool want_stem)
 	if (*PROG_GUNZIP) {
 		ext = strstr (filename, ".Z/");
 		if (ext) {
-			if (want_stem)
-				hpux_comp.stem =
-				        xstrndup (filename, ext - filename);
-			else
-				hpux_comp.stem = NULL;
+			hpux_comp.stem = NULL;
+			*stem_len = ext - filename;
 			return &hpux_comp;
 		}
 	}
@@ -22,6 +22,7 @@
  */
 
 #include <stdbool.h>
+#include <stddef.h>
 
 struct compression {
 	/* The following are const because they should be pointers to parts
@@ -39,4 +40,6 @@ struct compression {
 extern struct compression comp_list[];
 
 extern struct compression *comp_info (const char *filename, bool want_stem);
+extern struct compression *comp_info_len (const char *filename,
+                                          size_t *stem_len);
 extern struct compression *comp_file (const char *filename);
@@ -0,0 +1,255 @@
+/*
+ * dirstats.c: batch file status requests for whole directories
+ *
+ * Copyright (C) 2024 Colin Watson.
+ *
+ * This file is part of man-db.
+ *
+ * man-db is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * man-db is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with man-db; if not, write to the Free Software Foundation,
+ * Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ */
+
+#ifdef HAVE_CONFIG_H
+#  include "config.h"
+#endif /* HAVE_CONFIG_H */
+
+#ifdef HAVE_LIBURING
+#  include <liburing.h>
+#  include <sys/sysmacros.h>
+#endif /* HAVE_LIBURING */
+
+#include <errno.h>
+#include <fcntl.h>
+#include <stdbool.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <sys/types.h>
+#include <unistd.h>
+
+#include "attribute.h"
+#include "gl_hash_map.h"
+#include "gl_xmap.h"
+#include "xalloc.h"
+
+#include "manconfig.h"
+
+#include "cleanup.h"
+#include "debug.h"
+#include "glcontainers.h"
+
+#include "dirstats.h"
+
+struct dir_stats {
+	gl_map_t stats; /* name -> struct stat */
+};
+
+#ifdef HAVE_LIBURING
+
+/* The number of requests submitted to the kernel at once. */
+#  define DIR_STATS_QUEUE_DEPTH 64
+
+static struct io_uring ring;
+static bool ring_ready = false;
+static bool ring_unavailable = false;
+
+static void ring_exit (void *data MAYBE_UNUSED)
+{
+	if (ring_ready) {
+		io_uring_queue_exit (&ring);
+		ring_ready = false;
+	}
+}
+
+/* Set up the ring the first time it is needed.  io_uring may be missing
+ * from the running kernel, lack support for statx, or be disabled by
+ * policy; in any of those cases, remember not to try again.
+ */
+static bool ring_init (void)
+{
+	struct io_uring_probe *probe;
+	int ret;
+
+	if (ring_ready)
+		return true;
+	if (ring_unavailable)
+		return false;
+
+	ret = io_uring_queue_init (DIR_STATS_QUEUE_DEPTH, &ring, 0);
+	if (ret < 0) {
+		debug ("io_uring unavailable: %s\n", strerror (-ret));
+		ring_unavailable = true;
+		return false;
+	}
+
+	probe = io_uring_get_probe_ring (&ring);
+	if (!probe || !io_uring_opcode_supported (probe, IORING_OP_STATX)) {
+		debug ("io_uring does not support statx\n");
+		if (probe)
+			io_uring_free_probe (probe);
+		io_uring_queue_exit (&ring);
+		ring_unavailable = true;
+		return false;
+	}
+	io_uring_free_probe (probe);
+
+	ring_ready = true;
+	push_cleanup (ring_exit, NULL, 0);
+	return true;
+}
+
+static void statx_to_stat (const struct statx *stx, struct stat *st)
+{
+	memset (st, 0, sizeof *st);
+	st->st_dev = makedev (stx->stx_dev_major, stx->stx_dev_minor);
+	st->st_ino = stx->stx_ino;
+	st->st_mode = stx->stx_mode;
+	st->st_nlink = stx->stx_nlink;
+	st->st_uid = stx->stx_uid;
+	st->st_gid = stx->stx_gid;
+	st->st_rdev = makedev (stx->stx_rdev_major, stx->stx_rdev_minor);
+	st->st_size = stx->stx_size;
+	st->st_blksize = stx->stx_blksize;
+	st->st_blocks = stx->stx_blocks;
+	st->st_atim.tv_sec = stx->stx_atime.tv_sec;
+	st->st_atim.tv_nsec = stx->stx_atime.tv_nsec;
+	st->st_mtim.tv_sec = stx->stx_mtime.tv_sec;
+	st->st_mtim.tv_nsec = stx->stx_mtime.tv_nsec;
+	st->st_ctim.tv_sec = stx->stx_ctime.tv_sec;
+	st->st_ctim.tv_nsec = stx->stx_ctime.tv_nsec;
+}
+
+struct dir_stats *dir_stats_new (const char *dir, gl_list_t names)
+{
+	struct dir_stats *stats;
+	struct statx *bufs;
+	const char **batch;
+	size_t nnames = gl_list_size (names), i = 0;
+	int dir_fd_open_flags;
+	int dir_fd;
+
+	if (!nnames || !ring_init ())
+		return NULL;
+
+	dir_fd_open_flags = O_SEARCH | O_DIRECTORY;
+#  ifdef O_PATH
+	dir_fd_open_flags |= O_PATH;
+#  endif
+	dir_fd = open (dir, dir_fd_open_flags);
+	if (dir_fd < 0)
+		return NULL;
+
+	stats = XMALLOC (struct dir_stats);
+	stats->stats = new_string_map (GL_HASH_MAP, plain_free);
+	bufs = XNMALLOC (DIR_STATS_QUEUE_DEPTH, struct statx);
+	batch = XNMALLOC (DIR_STATS_QUEUE_DEPTH, const char *);
+
+	while (i < nnames) {
+		unsigned n, j;
+		int submitted;
+
+		for (n = 0; n < DIR_STATS_QUEUE_DEPTH && i < nnames;
+		     ++n, ++i) {
+			struct io_uring_sqe *sqe = io_uring_get_sqe (&ring);
+
+			batch[n] = gl_list_get_at (names, i);
+			io_uring_prep_statx (sqe, dir_fd, batch[n],
+			                     AT_SYMLINK_NOFOLLOW,
+			                     STATX_BASIC_STATS, &bufs[n]);
+			io_uring_sqe_set_data (sqe, &bufs[n]);
+		}
+
+		submitted = io_uring_submit (&ring);
+		if (submitted < 0)
+			goto broken;
+
+		for (j = 0; j < (unsigned) submitted; ++j) {
+			struct io_uring_cqe *cqe;
+			size_t slot;
+			int ret;
+
+			do
+				ret = io_uring_wait_cqe (&ring, &cqe);
+			while (ret == -EINTR);
+			if (ret < 0)
+				goto broken;
+			slot = (struct statx *) io_uring_cqe_get_data (cqe) -
+			       bufs;
+			if (cqe->res == 0) {
+				struct stat *st = XMALLOC (struct stat);
+
+				statx_to_stat (&bufs[slot], st);
+				gl_map_put (stats->stats, xstrdup (batch[slot]),
+				            st);
+			}
+			io_uring_cqe_seen (&ring, cqe);
+		}
+		if ((unsigned) submitted < n)
+			goto broken;
+	}
+
+	debug ("io_uring: %zu of %zu names in %s statted\n",
+	       gl_map_size (stats->stats), nnames, dir);
+	goto out;
+
+broken:
+	/* Requests may still be in flight, so the ring can't be reused;
+	 * give up on it and let everyone fall back to lstat.  The kernel
+	 * may yet write to bufs, so deliberately leak it.
+	 */
+	debug ("io_uring request failed; falling back to lstat\n");
+	ring_exit (NULL);
+	ring_unavailable = true;
+	dir_stats_free (stats);
+	stats = NULL;
+	bufs = NULL;
+
+out:
+	free (batch);
+	free (bufs);
+	close (dir_fd);
+	return stats;
+}
+
+#else /* !HAVE_LIBURING */
+
+struct dir_stats *dir_stats_new (const char *dir MAYBE_UNUSED,
+                                 gl_list_t names MAYBE_UNUSED)
+{
+	return NULL;
+}
+
+#endif /* HAVE_LIBURING */
+
+bool dir_stats_get (const struct dir_stats *stats, const char *name,
+                    struct stat *st)
+{
+	const struct stat *found;
+
+	if (!stats)
+		return false;
+	found = gl_map_get (stats->stats, name);
+	if (!found)
+		return false;
+	*st = *found;
+	return true;
+}
+
+void dir_stats_free (struct dir_stats *stats)
+{
+	if (!stats)
+		return;
+	gl_map_free (stats->stats);
+	free (stats);
+}
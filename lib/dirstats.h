@@ -0,0 +1,48 @@
+/*
+ * dirstats.h: interface to batched file status requests
+ *
+ * Copyright (C) 2024 Colin Watson.
+ *
+ * This file is part of man-db.
+ *
+ * man-db is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * man-db is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with man-db; if not, write to the Free Software Foundation,
+ * Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ */
+
+#ifndef MAN_DIRSTATS_H
+#define MAN_DIRSTATS_H
+
+#include <stdbool.h>
+#include <sys/stat.h>
+
+#include "gl_list.h"
+
+/* The lstat results for a set of names in one directory. */
+struct dir_stats;
+
+/* Fetch the lstat results for all of NAMES in DIR at once.  Returns NULL
+ * if this cannot be done any faster than calling lstat for each name, in
+ * which case callers should do just that.
+ */
+struct dir_stats *dir_stats_new (const char *dir, gl_list_t names);
+
+/* Copy the lstat result for NAME into ST.  Returns false if it is not
+ * known (including if STATS is NULL).
+ */
+bool dir_stats_get (const struct dir_stats *stats, const char *name,
+                    struct stat *st);
+
+void dir_stats_free (struct dir_stats *stats);
+
+#endif /* MAN_DIRSTATS_H */
@@ -41,9 +41,11 @@
 #include "manconfig.h"
 
 #include "appendstr.h"
+#include "arena.h"
 #include "compression.h"
 #include "debug.h"
 #include "filenames.h"
+#include "intern.h"
 
 static void gripe_bogus_manpage (const char *manpage)
 {
@@ -84,81 +86,93 @@ char *make_filename (const char *path, const char *name, struct mandata *in,
  *
  * Only the fields name, ext, sec, and comp are filled in by this function.
  */
-struct mandata *filename_info (const char *file, bool warn_if_bogus)
+static struct mandata *parse_filename (const char *file, bool warn_if_bogus,
+                                       struct arena *arena)
 {
 	struct mandata *info;
-	char *basename, *dirname;
+	char *basename, *dirname, *ext;
 	struct compression *comp;
-
-	info = XZALLOC (struct mandata);
-
-	basename = base_name (file);
+	size_t stem_len;
+
+	if (arena) {
+		info = arena_alloc (arena, sizeof *info);
+		memset (info, 0, sizeof *info);
+		basename = arena_strdup (arena, last_component (file));
+	} else {
+		info = XZALLOC (struct mandata);
+		basename = base_name (file);
+	}
 
 	/* Bogus files either have (i) no period, ie no extension, (ii)
 	   a compression extension, but no sectional extension, (iii)
 	   a mismatch between the section they are under and the
 	   sectional part of their extension. */
 
-	comp = comp_info (basename, true);
+	comp = comp_info_len (basename, &stem_len);
 	if (comp) {
-		info->comp = xstrdup (comp->ext);
-		*(basename + strlen (comp->stem)) = '\0';
-		free (comp->stem);
+		info->comp = intern_string (comp->ext);
+		basename[stem_len] = '\0';
 	} else
 		info->comp = NULL;
 
-	{
-		char *ext = strrchr (basename, '.');
-		if (!ext) {
-			/* no section extension */
-			if (warn_if_bogus)
-				gripe_bogus_manpage (file);
-			free (basename);
-			free_mandata_struct (info);
-			return NULL;
-		}
-		*ext++ = '\0'; /* set section ext */
-		info->ext = xstrdup (ext);
-		if (!*info->ext) {
-			/* zero-length section extension */
-			if (warn_if_bogus)
-				gripe_bogus_manpage (file);
-			free (basename);
-			free_mandata_struct (info);
-			return NULL;
-		}
-	}
+	ext = strrchr (basename, '.');
+	if (!ext)
+		/* no section extension */
+		goto bogus;
+	*ext++ = '\0'; /* set section ext */
+	info->ext = intern_string (ext);
+	if (!*info->ext)
+		/* zero-length section extension */
+		goto bogus;
 
 	/* Set section name. */
-	dirname = dir_name (file);
-	info->sec = xstrdup (strrchr (dirname, '/') + 4);
-	free (dirname);
+	if (arena)
+		dirname = arena_strndup (arena, file, dir_len (file));
+	else
+		dirname = dir_name (file);
+	info->sec = intern_string (strrchr (dirname, '/') + 4);
+	if (!arena)
+		free (dirname);
 
 	if (strlen (info->sec) >= 1 && strlen (info->ext) >= 1 &&
-	    info->sec[0] != info->ext[0]) {
+	    info->sec[0] != info->ext[0])
 		/* mismatch in section */
-		if (warn_if_bogus)
-			gripe_bogus_manpage (file);
+		goto bogus;
+
+	info->name = basename;
+
+	return info;
+
+bogus:
+	if (warn_if_bogus)
+		gripe_bogus_manpage (file);
+	if (!arena) {
 		free (basename);
 		free_mandata_struct (info);
-		return NULL;
 	}
+	return NULL;
+}
 
-	info->name = xstrdup (basename);
+struct mandata *filename_info (const char *file, bool warn_if_bogus)
+{
+	return parse_filename (file, warn_if_bogus, NULL);
+}
 
-	return info;
+/* Like filename_info, but allocate the result from ARENA, so that it must
+ * not be passed to free_mandata_struct.
+ */
+struct mandata *filename_info_arena (const char *file, bool warn_if_bogus,
+                                     struct arena *arena)
+{
+	return parse_filename (file, warn_if_bogus, arena);
 }
 
-/* Free a mandata structure and its elements. */
+/* Free a mandata structure and its elements, other than the interned ones. */
 void free_mandata_struct (struct mandata *pinfo)
 {
 	if (pinfo) {
 		free (pinfo->name);
-		free (pinfo->ext);
-		free (pinfo->sec);
 		free (pinfo->pointer);
-		free (pinfo->comp);
-		free (pinfo->filter);
 		free (pinfo->whatis);
 	}
 	free (pinfo);
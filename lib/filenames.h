@@ -27,23 +27,31 @@
 
 #include "timespec.h"
 
+/* The ext, sec, comp, and filter fields take only a few distinct values
+ * across a whole hierarchy, so they are interned (see intern.h) rather than
+ * allocated for each page, and are not freed by free_mandata_struct.
+ */
 struct mandata {
 	/* Name of page, if not equal to the key. */
 	char *name;
-	/* Filename extension without compression extension. */
-	char *ext;
-	/* Section name/number. */
-	char *sec;
+	/* Filename extension without compression extension (interned). */
+	const char *ext;
+	/* Section name/number (interned). */
+	const char *sec;
 	/* ID (i.e. type) of this entry. */
 	char id;
 	/* ID-related file pointer. */
 	char *pointer;
-	/* Compression extension. */
-	char *comp;
-	/* Filters needed for the page. */
-	char *filter;
+	/* Compression extension (interned). */
+	const char *comp;
+	/* Filters needed for the page (interned). */
+	const char *filter;
 	/* Whatis description for the page. */
 	char *whatis;
+	/* Reference to a shared description to store in place of whatis
+	 * (not owned; only used when storing).
+	 */
+	const char *whatis_ref;
 	/* Modification time for file. */
 	struct timespec mtime;
 };
@@ -51,6 +59,10 @@ struct mandata {
 extern char *make_filename (const char *path, const char *name,
                             struct mandata *in, const char *type);
 extern struct mandata *filename_info (const char *file, bool warn_if_bogus);
+struct arena;
+extern struct mandata *filename_info_arena (const char *file,
+                                            bool warn_if_bogus,
+                                            struct arena *arena);
 extern void free_mandata_struct (struct mandata *pinfo);
 
 #endif /* MAN_FILENAMES_H */
@@ -0,0 +1,66 @@
+/*
+ * intern.c: table of interned strings
+ *
+ * Copyright (C) 2024 Colin Watson.
+ *
+ * This file is part of man-db.
+ *
+ * man-db is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * man-db is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with man-db; if not, write to the Free Software Foundation,
+ * Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ */
+
+#ifdef HAVE_CONFIG_H
+#  include "config.h"
+#endif /* HAVE_CONFIG_H */
+
+#include <stdbool.h>
+#include <stddef.h>
+
+#include "gl_hash_map.h"
+#include "gl_xmap.h"
+#include "xalloc.h"
+
+#include "manconfig.h"
+
+#include "cleanup.h"
+#include "glcontainers.h"
+#include "intern.h"
+
+/* Maps each string to itself.  The map owns the keys. */
+static gl_map_t interned;
+
+static void free_interned (void *arg MAYBE_UNUSED)
+{
+	gl_map_free (interned);
+	interned = NULL;
+}
+
+const char *intern_string (const char *str)
+{
+	const void *found;
+	char *copy;
+
+	if (!str)
+		return NULL;
+
+	if (!interned) {
+		interned = new_string_map (GL_HASH_MAP, NULL);
+		push_cleanup (free_interned, NULL, 0);
+	} else if (gl_map_search (interned, str, &found))
+		return found;
+
+	copy = xstrdup (str);
+	gl_map_put (interned, copy, copy);
+	return copy;
+}
@@ -0,0 +1,34 @@
+/*
+ * intern.h: interface to the table of interned strings
+ *
+ * Copyright (C) 2024 Colin Watson.
+ *
+ * This file is part of man-db.
+ *
+ * man-db is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * man-db is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with man-db; if not, write to the Free Software Foundation,
+ * Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ */
+
+#ifndef MAN_INTERN_H
+#define MAN_INTERN_H
+
+/* Return the canonical copy of STR, or NULL if STR is NULL.  Equal strings
+ * share a single copy, so interned strings may be compared as pointers.
+ * Interned strings must not be freed or modified, and last until the
+ * program exits; only intern values drawn from a small set, such as
+ * section names and compression extensions.
+ */
+extern const char *intern_string (const char *str);
+
+#endif /* MAN_INTERN_H */
@@ -1,7 +1,7 @@
 /*
  * orderfiles.c: order file accesses to optimise disk load
  *
- * Copyright (C) 2014 Colin Watson.
+ * Copyright (C) 2014, 2024 Colin Watson.
  *
  * Inspired by and loosely based on dpkg/src/filesdb.c, which is:
  *   Copyright (C) 1995 Ian Jackson <ian@chiark.greenend.org.uk>
@@ -33,11 +33,13 @@
 #  include <linux/fiemap.h>
 #  include <linux/fs.h>
 #  include <sys/ioctl.h>
+#  include <sys/sysmacros.h>
 #  include <sys/vfs.h>
 #endif /* HAVE_LINUX_FIEMAP_H */
 
 #include <fcntl.h>
 #include <stdint.h>
+#include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
 #include <sys/stat.h>
@@ -45,75 +47,160 @@
 #include <unistd.h>
 
 #include "attribute.h"
-#include "gl_hash_map.h"
-#include "gl_rbtree_list.h"
+#include "gl_array_list.h"
 #include "gl_xlist.h"
-#include "gl_xmap.h"
 #include "xalloc.h"
+#include "xvasprintf.h"
 
 #include "manconfig.h"
 
+#include "debug.h"
 #include "glcontainers.h"
 #include "orderfiles.h"
 
+/* How many files ahead of the reader to ask the kernel to preload. */
+#define READAHEAD_WINDOW 16
+
+/* How much of each file to preload.  Manual pages are usually small. */
+#define READAHEAD_BYTES 65536
+
+enum order_policy {
+	ORDER_AUTO,
+	ORDER_NONE,
+	ORDER_FIEMAP,
+	ORDER_READAHEAD
+};
+
+struct file_order {
+	int dir_fd;
+	gl_list_t basenames;
+	size_t consumed; /* files handed to the reader so far */
+	size_t advised;  /* files preloaded so far */
+};
+
+static int open_dir (const char *dir)
+{
+	int dir_fd_open_flags;
+
+	dir_fd_open_flags = O_SEARCH | O_DIRECTORY;
+#ifdef O_PATH
+	dir_fd_open_flags |= O_PATH;
+#endif
+	return open (dir, dir_fd_open_flags);
+}
+
+static enum order_policy get_requested_policy (void)
+{
+	const char *policy = getenv ("MAN_ORDER_FILES");
+
+	if (!policy || !*policy || STREQ (policy, "auto"))
+		return ORDER_AUTO;
+	else if (STREQ (policy, "none"))
+		return ORDER_NONE;
+	else if (STREQ (policy, "fiemap"))
+		return ORDER_FIEMAP;
+	else if (STREQ (policy, "readahead"))
+		return ORDER_READAHEAD;
+
+	debug ("unknown MAN_ORDER_FILES policy '%s'; using auto\n", policy);
+	return ORDER_AUTO;
+}
+
 #if defined(HAVE_LINUX_FIEMAP_H)
-static gl_map_t physical_offsets = NULL;
+/* Return true if the block device holding DEV has spinning disks (or
+ * claims to), or false if it doesn't or we can't tell.  Remember the
+ * answer for the last device asked about, since we are usually asked
+ * about many directories on the same file system in a row.
+ */
+static bool is_rotational (dev_t dev)
+{
+	static dev_t cached_dev;
+	static bool cached_rotational, cached = false;
+	char *path;
+	FILE *file;
+	int rotational = 0;
 
-static int compare_physical_offsets (const void *a, const void *b)
+	if (cached && cached_dev == dev)
+		return cached_rotational;
+
+	/* Partitions don't have a queue directory of their own, but their
+	 * parent device does.
+	 */
+	path = xasprintf ("/sys/dev/block/%u:%u/queue/rotational",
+	                  major (dev), minor (dev));
+	file = fopen (path, "r");
+	free (path);
+	if (!file) {
+		path = xasprintf ("/sys/dev/block/%u:%u/../queue/rotational",
+		                  major (dev), minor (dev));
+		file = fopen (path, "r");
+		free (path);
+	}
+	if (file) {
+		if (fscanf (file, "%d", &rotational) != 1)
+			rotational = 0;
+		fclose (file);
+	}
+
+	cached_dev = dev;
+	cached_rotational = rotational > 0;
+	cached = true;
+	debug ("device %u:%u is %srotational\n", major (dev), minor (dev),
+	       cached_rotational ? "" : "not ");
+	return cached_rotational;
+}
+
+struct file_offset {
+	const char *name;
+	uint64_t offset;
+	size_t index;
+};
+
+static int compare_file_offsets (const void *a, const void *b)
 {
-	const char *left = (const char *) a;
-	const char *right = (const char *) b;
-	const uint64_t *left_offset_p = gl_map_get (physical_offsets, left);
-	const uint64_t *right_offset_p = gl_map_get (physical_offsets, right);
-	uint64_t left_offset = left_offset_p ? *left_offset_p : UINT64_MAX;
-	uint64_t right_offset = right_offset_p ? *right_offset_p : UINT64_MAX;
-
-	if (left_offset < right_offset)
-		return -1;
-	else if (left_offset > right_offset)
-		return 1;
-	else
-		return 0;
+	const struct file_offset *left = (const struct file_offset *) a;
+	const struct file_offset *right = (const struct file_offset *) b;
+
+	if (left->offset != right->offset)
+		return left->offset < right->offset ? -1 : 1;
+	/* Keep the sort stable. */
+	return left->index < right->index ? -1 : left->index > right->index;
 }
 
 #  define MAN_FIEMAP_SIZE                                                     \
 	  (sizeof (struct fiemap) + sizeof (struct fiemap_extent))
 
-void order_files (const char *dir, gl_list_t *basenamesp)
+/* Sort files by the physical locations of their first blocks, in an
+ * attempt to minimise disk drive head movements.  This assumes that files
+ * are small enough that they are likely to be in one block or a small
+ * number of contiguous blocks, which seems a reasonable assumption for
+ * manual pages.
+ *
+ * Each file's offset is looked up once and stored alongside its name, so
+ * that sorting doesn't need to look anything up.  Files whose offsets are
+ * unknown go at the end.
+ */
+static void order_by_fiemap (int dir_fd, gl_list_t *basenamesp)
 {
 	gl_list_t basenames = *basenamesp, sorted_basenames;
-	int dir_fd_open_flags;
-	int dir_fd;
 	struct statfs fs;
-	const char *name;
-	struct fiemap *fm = xmalloc (MAN_FIEMAP_SIZE);
-
-	dir_fd_open_flags = O_SEARCH | O_DIRECTORY;
-#  ifdef O_PATH
-	dir_fd_open_flags |= O_PATH;
-#  endif
-	dir_fd = open (dir, dir_fd_open_flags);
-	if (dir_fd < 0)
-		return;
+	struct fiemap *fm;
+	struct file_offset *offsets;
+	size_t count = gl_list_size (basenames), i;
 
-	if (fstatfs (dir_fd, &fs) < 0) {
-		close (dir_fd);
+	if (fstatfs (dir_fd, &fs) < 0)
 		return;
-	}
 
-	/* Sort files by the physical locations of their first blocks, in an
-	 * attempt to minimise disk drive head movements.  This assumes that
-	 * files are small enough that they are likely to be in one block or
-	 * a small number of contiguous blocks, which seems a reasonable
-	 * assumption for manual pages.
-	 */
-	physical_offsets = gl_map_create_empty (GL_HASH_MAP, string_equals,
-	                                        string_hash, NULL, plain_free);
-	sorted_basenames = new_string_list (GL_RBTREE_LIST, false);
-	GL_LIST_FOREACH (basenames, name) {
+	fm = xmalloc (MAN_FIEMAP_SIZE);
+	offsets = XNMALLOC (count, struct file_offset);
+	for (i = 0; i < count; ++i) {
 		int fd;
 
-		fd = openat (dir_fd, name, O_RDONLY);
+		offsets[i].name = gl_list_get_at (basenames, i);
+		offsets[i].offset = UINT64_MAX;
+		offsets[i].index = i;
+
+		fd = openat (dir_fd, offsets[i].name, O_RDONLY);
 		if (fd < 0)
 			continue;
 
@@ -123,59 +210,122 @@ void order_files (const char *dir, gl_list_t *basenamesp)
 		fm->fm_flags = 0;
 		fm->fm_extent_count = 1;
 
-		if (ioctl (fd, FS_IOC_FIEMAP, (unsigned long) fm) == 0) {
-			uint64_t *offset = XMALLOC (uint64_t);
-			*offset = fm->fm_extents[0].fe_physical;
-			/* Borrow the key from basenames; since
-			 * physical_offsets has a shorter lifetime, we don't
-			 * need to duplicate it.
-			 */
-			gl_map_put (physical_offsets, name, offset);
-		}
+		if (ioctl (fd, FS_IOC_FIEMAP, (unsigned long) fm) == 0 &&
+		    fm->fm_mapped_extents)
+			offsets[i].offset = fm->fm_extents[0].fe_physical;
 
 		close (fd);
-		gl_sortedlist_add (sorted_basenames, compare_physical_offsets,
-		                   xstrdup (name));
 	}
-	gl_map_free (physical_offsets);
-	physical_offsets = NULL;
 	free (fm);
-	close (dir_fd);
+
+	qsort (offsets, count, sizeof *offsets, compare_file_offsets);
+
+	sorted_basenames = new_string_list (GL_ARRAY_LIST, false);
+	for (i = 0; i < count; ++i)
+		gl_list_add_last (sorted_basenames, xstrdup (offsets[i].name));
+	free (offsets);
 	gl_list_free (basenames);
 	*basenamesp = sorted_basenames;
 }
+#endif /* HAVE_LINUX_FIEMAP_H */
+
+static enum order_policy choose_policy (int dir_fd MAYBE_UNUSED)
+{
+	enum order_policy policy = get_requested_policy ();
+
+#if defined(HAVE_LINUX_FIEMAP_H)
+	if (policy == ORDER_AUTO) {
+		struct stat st;
+
+		if (fstat (dir_fd, &st) == 0 && is_rotational (st.st_dev))
+			policy = ORDER_FIEMAP;
+		else
+			policy = ORDER_READAHEAD;
+	}
+#else
+	if (policy == ORDER_AUTO || policy == ORDER_FIEMAP)
+		policy = ORDER_READAHEAD;
+#endif
+
+#if !defined(HAVE_READAHEAD) && !defined(HAVE_POSIX_FADVISE)
+	if (policy == ORDER_READAHEAD)
+		policy = ORDER_NONE;
+#endif
+
+	return policy;
+}
+
+/* Ask the kernel to start reading the next file in the window. */
+static void advise_next (struct file_order *order)
+{
+	const char *name = gl_list_get_at (order->basenames, order->advised++);
+	int fd;
+
+	fd = openat (order->dir_fd, name, O_RDONLY | O_NONBLOCK | O_CLOEXEC);
+	if (fd < 0)
+		return;
+#if defined(HAVE_READAHEAD)
+	readahead (fd, 0, READAHEAD_BYTES);
 #elif defined(HAVE_POSIX_FADVISE)
-void order_files (const char *dir, gl_list_t *basenamesp)
+	posix_fadvise (fd, 0, READAHEAD_BYTES, POSIX_FADV_WILLNEED);
+#endif
+	close (fd);
+}
+
+static void fill_window (struct file_order *order)
 {
-	gl_list_t basenames = *basenamesp;
-	int dir_fd_open_flags;
+	size_t count = gl_list_size (order->basenames);
+
+	while (order->advised < count &&
+	       order->advised < order->consumed + READAHEAD_WINDOW)
+		advise_next (order);
+}
+
+struct file_order *order_files (const char *dir, gl_list_t *basenamesp)
+{
+	struct file_order *order;
 	int dir_fd;
-	const char *name;
 
-	dir_fd_open_flags = O_SEARCH | O_DIRECTORY;
-#  ifdef O_PATH
-	dir_fd_open_flags |= O_PATH;
-#  endif
-	dir_fd = open (dir, dir_fd_open_flags);
+	if (!gl_list_size (*basenamesp))
+		return NULL;
+
+	dir_fd = open_dir (dir);
 	if (dir_fd < 0)
-		return;
+		return NULL;
 
-	/* While we can't actually order the files, we can at least ask the
-	 * kernel to preload them.
-	 */
-	GL_LIST_FOREACH (basenames, name) {
-		int fd = openat (dir_fd, name, O_RDONLY | O_NONBLOCK);
-		if (fd >= 0) {
-			posix_fadvise (fd, 0, 0, POSIX_FADV_WILLNEED);
-			close (fd);
-		}
+	switch (choose_policy (dir_fd)) {
+#if defined(HAVE_LINUX_FIEMAP_H)
+		case ORDER_FIEMAP:
+			order_by_fiemap (dir_fd, basenamesp);
+			close (dir_fd);
+			return NULL;
+#endif
+		case ORDER_READAHEAD:
+			order = XMALLOC (struct file_order);
+			order->dir_fd = dir_fd;
+			order->basenames = *basenamesp;
+			order->consumed = 0;
+			order->advised = 0;
+			fill_window (order);
+			return order;
+		default:
+			close (dir_fd);
+			return NULL;
 	}
+}
 
-	close (dir_fd);
+void order_files_next (struct file_order *order)
+{
+	if (!order)
+		return;
+	++order->consumed;
+	fill_window (order);
 }
-#else
-void order_files (const char *dir MAYBE_UNUSED,
-                  gl_list_t *basenamesp MAYBE_UNUSED)
+
+void order_files_free (struct file_order *order)
 {
+	if (!order)
+		return;
+	close (order->dir_fd);
+	free (order);
 }
-#endif
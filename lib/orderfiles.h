@@ -22,4 +22,18 @@
 
 #include "gl_list.h"
 
-void order_files (const char *dir, gl_list_t *basenamesp);
+struct file_order;
+
+/* Prepare to read the files named in *BASENAMESP, relative to DIR, in
+ * whichever way suits the underlying storage: this may reorder
+ * *BASENAMESP.  The policy is chosen by $MAN_ORDER_FILES ("none",
+ * "fiemap", or "readahead"), or by default according to whether the
+ * device is rotational.
+ *
+ * Returns a handle (which may be NULL) to be passed to order_files_next
+ * each time the caller moves on to the next file, and finally to
+ * order_files_free.  *BASENAMESP must not change until then.
+ */
+struct file_order *order_files (const char *dir, gl_list_t *basenamesp);
+void order_files_next (struct file_order *order);
+void order_files_free (struct file_order *order);
@@ -27,6 +27,18 @@
 #include <assert.h>
 #include <stdbool.h>
 #include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+
+#if defined(__SSE2__)
+#  include <emmintrin.h>
+#endif /* __SSE2__ */
+#if defined(__AVX2__)
+#  include <immintrin.h>
+#endif /* __AVX2__ */
+#if defined(__ARM_NEON) && defined(__aarch64__)
+#  include <arm_neon.h>
+#endif /* __ARM_NEON && __aarch64__ */
 
 #include "attribute.h"
 
@@ -40,6 +52,75 @@
 			goto error;                                           \
 	} while (0)
 
+/* Return the first byte at or after p that is either NUL or not ASCII, or
+ * end if there is none.  Most manual pages are almost entirely ASCII, so
+ * checking as many bytes at a time as the CPU allows pays off; the vector
+ * paths only need to notice that a block contains something interesting,
+ * and leave finding exactly where to the byte-at-a-time loop at the end.
+ */
+static const char *ATTRIBUTE_PURE skip_ascii (const char *p, const char *end)
+{
+#if defined(__AVX2__)
+	const __m256i zero256 = _mm256_setzero_si256 ();
+#endif
+#if defined(__SSE2__)
+	const __m128i zero = _mm_setzero_si128 ();
+#elif !defined(__ARM_NEON) || !defined(__aarch64__)
+	const uint64_t ones = UINT64_C (0x0101010101010101);
+	const uint64_t highs = UINT64_C (0x8080808080808080);
+#endif
+
+	/* Text in other scripts tends to have multibyte characters back to
+	 * back; don't bother loading a whole block to find that out.
+	 */
+	if (p < end && *(unsigned char *) p >= 128)
+		return p;
+
+#if defined(__AVX2__)
+	while (end - p >= 32) {
+		__m256i chunk = _mm256_loadu_si256 ((const __m256i *) p);
+
+		if (_mm256_movemask_epi8 (chunk) ||
+		    _mm256_movemask_epi8 (_mm256_cmpeq_epi8 (chunk, zero256)))
+			break;
+		p += 32;
+	}
+#endif /* __AVX2__ */
+#if defined(__SSE2__)
+	while (end - p >= 16) {
+		__m128i chunk = _mm_loadu_si128 ((const __m128i *) p);
+
+		if (_mm_movemask_epi8 (chunk) ||
+		    _mm_movemask_epi8 (_mm_cmpeq_epi8 (chunk, zero)))
+			break;
+		p += 16;
+	}
+#elif defined(__ARM_NEON) && defined(__aarch64__)
+	while (end - p >= 16) {
+		uint8x16_t chunk = vld1q_u8 ((const uint8_t *) p);
+
+		if (vmaxvq_u8 (chunk) >= 0x80 || vminvq_u8 (chunk) == 0)
+			break;
+		p += 16;
+	}
+#else
+	/* Portable fallback: eight bytes at a time. */
+	while (end - p >= 8) {
+		uint64_t word;
+
+		memcpy (&word, p, sizeof word);
+		if ((word & highs) || ((word - ones) & ~word & highs))
+			break;
+		p += 8;
+	}
+#endif
+
+	while (p < end && *(unsigned char *) p &&
+	       *(unsigned char *) p < 128)
+		p++;
+	return p;
+}
+
 /* see IETF RFC 3629 Section 4 */
 
 static const char *ATTRIBUTE_PURE fast_validate_len (const char *str,
@@ -48,12 +129,10 @@ static const char *ATTRIBUTE_PURE fast_validate_len (const char *str,
 	const char *p;
 	const char *end = str + max_len;
 
-	for (p = str; p < end && *p; p++) {
+	for (p = skip_ascii (str, end); p < end && *p;
+	     p = skip_ascii (p + 1, end)) {
 		const char *last;
 
-		if (*(unsigned char *) p < 128)
-			continue;
-
 		last = p;
 		if (*(unsigned char *) p < 0xe0) {
 			/* 110xxxxx */
@@ -136,3 +215,12 @@ bool ATTRIBUTE_PURE utf8_validate_len (const char *str, size_t max_len)
 
 	return p == str + max_len;
 }
+
+/* Returns the number of bytes at the start of str, up to max_len, that
+ * form valid UTF-8 text.  As with utf8_validate_len(), a NUL byte ends the
+ * valid prefix.
+ */
+size_t ATTRIBUTE_PURE utf8_valid_prefix (const char *str, size_t max_len)
+{
+	return fast_validate_len (str, max_len) - str;
+}
@@ -24,3 +24,4 @@
 #include <stddef.h>
 
 bool utf8_validate_len (const char *str, size_t max_len);
+size_t utf8_valid_prefix (const char *str, size_t max_len);
@@ -0,0 +1,115 @@
+/*
+ * db_cache.c: keep read-only database handles open between lookups
+ *
+ * Copyright (C) 2024 Colin Watson.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ */
+
+#ifdef HAVE_CONFIG_H
+#  include "config.h"
+#endif
+
+#include <stdbool.h>
+#include <stdlib.h>
+#include <sys/stat.h>
+#include <sys/types.h>
+
+#include "gl_hash_map.h"
+#include "gl_xmap.h"
+#include "stat-time.h"
+#include "timespec.h"
+#include "xalloc.h"
+#include "xvasprintf.h"
+
+#include "manconfig.h"
+
+#include "debug.h"
+#include "glcontainers.h"
+
+#include "mydbm.h"
+
+struct cached_db {
+	MYDBM_FILE dbf;
+	dev_t dev;
+	ino_t ino;
+	struct timespec mtime;
+};
+
+static gl_map_t cached_dbs;
+
+static void cached_db_free (const void *value)
+{
+	struct cached_db *db = (struct cached_db *) value;
+
+	MYDBM_FREE (db->dbf);
+	free (db);
+}
+
+static bool stat_db (const char *database, struct stat *st)
+{
+#ifdef NDBM
+	char *dirfile = xasprintf ("%s.dir", database);
+	bool ret = stat (dirfile, st) == 0;
+	free (dirfile);
+	return ret;
+#else
+	return stat (database, st) == 0;
+#endif
+}
+
+MYDBM_FILE dbcache_open (const char *database)
+{
+	struct cached_db *db;
+	struct stat st;
+
+	if (!stat_db (database, &st))
+		return NULL;
+
+	if (!cached_dbs)
+		cached_dbs = new_string_map (GL_HASH_MAP, cached_db_free);
+
+	db = (struct cached_db *) gl_map_get (cached_dbs, database);
+	if (db) {
+		if (db->dev == st.st_dev && db->ino == st.st_ino &&
+		    timespec_cmp (db->mtime, get_stat_mtime (&st)) == 0) {
+			debug ("reusing open database %s\n", database);
+			return db->dbf;
+		}
+		debug ("database %s has changed; reopening\n", database);
+		gl_map_remove (cached_dbs, database);
+	}
+
+	db = XMALLOC (struct cached_db);
+	db->dbf = MYDBM_NEW (database);
+	if (!MYDBM_RDOPEN (db->dbf) || dbver_rd (db->dbf)) {
+		cached_db_free (db);
+		return NULL;
+	}
+	db->dev = st.st_dev;
+	db->ino = st.st_ino;
+	db->mtime = get_stat_mtime (&st);
+	gl_map_put (cached_dbs, xstrdup (database), db);
+
+	return db->dbf;
+}
+
+void dbcache_close_all (void)
+{
+	if (cached_dbs) {
+		gl_map_free (cached_dbs);
+		cached_dbs = NULL;
+	}
+}
@@ -53,6 +53,7 @@
 #include "fatal.h"
 #include "filenames.h"
 #include "glcontainers.h"
+#include "intern.h"
 #include "wordfnmatch.h"
 #include "xregcomp.h"
 
@@ -158,7 +159,7 @@ char *name_to_key (const char *name)
 }
 
 /* return char ptr array to the data's fields */
-static char **split_data (MYDBM_FILE dbf, char *content, char *start[])
+char **split_data (MYDBM_FILE dbf, char *content, char *start[])
 {
 	int count;
 
@@ -187,6 +188,44 @@ static char **split_data (MYDBM_FILE dbf, char *content, char *start[])
 	return start;
 }
 
+/* Does the whatis field WHATIS refer to a shared description rather than
+ * holding one itself?
+ */
+bool ATTRIBUTE_PURE is_whatis_reference (const char *whatis)
+{
+	return STRNEQ (whatis, WHATIS_STRING_PREFIX,
+	               sizeof WHATIS_STRING_PREFIX - 1);
+}
+
+/* Return the description held in the whatis field FIELD, which must not
+ * be a reference.
+ */
+const char *ATTRIBUTE_PURE whatis_field_text (const char *field)
+{
+	return STRNEQ (field, "$$", 2) ? field + 1 : field;
+}
+
+/* Return a copy of the shared description that REF refers to, or of the
+ * empty string if it has gone missing.
+ */
+char *dbfetch_whatis (MYDBM_FILE dbf, const char *ref)
+{
+	datum key, cont;
+	char *whatis;
+
+	memset (&key, 0, sizeof key);
+	MYDBM_SET (key, xstrdup (ref));
+	cont = MYDBM_FETCH (dbf, key);
+	MYDBM_FREE_DPTR (key);
+	if (!MYDBM_DPTR (cont)) {
+		debug ("shared description %s missing\n", ref);
+		return xstrdup ("");
+	}
+	whatis = xstrdup (MYDBM_DPTR (cont));
+	MYDBM_FREE_DPTR (cont);
+	return whatis;
+}
+
 /* Parse the db-returned data and put it into a mandata format */
 struct mandata *split_content (MYDBM_FILE dbf, char *cont_ptr)
 {
@@ -198,15 +237,18 @@ struct mandata *split_content (MYDBM_FILE dbf, char *cont_ptr)
 
 	info = XZALLOC (struct mandata);
 	info->name = copy_if_set (*(data++));
-	info->ext = xstrdup (*(data++));
-	info->sec = xstrdup (*(data++));
+	info->ext = intern_string (*(data++));
+	info->sec = intern_string (*(data++));
 	info->mtime.tv_sec = (time_t) atol (*(data++));
 	info->mtime.tv_nsec = atol (*(data++));
 	info->id = **(data++); /* single char id */
 	info->pointer = xstrdup (*(data++));
-	info->filter = xstrdup (*(data++));
-	info->comp = xstrdup (*(data++));
-	info->whatis = xstrdup (*(data));
+	info->filter = intern_string (*(data++));
+	info->comp = intern_string (*(data++));
+	if (is_whatis_reference (*data))
+		info->whatis = dbfetch_whatis (dbf, *data);
+	else
+		info->whatis = xstrdup (whatis_field_text (*data));
 	return info;
 }
 
@@ -0,0 +1,343 @@
+/*
+ * db_snapshot.c: columnar snapshots of a database
+ *
+ * Copyright (C) 2024 Colin Watson.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ */
+
+#ifdef HAVE_CONFIG_H
+#  include "config.h"
+#endif /* HAVE_CONFIG_H */
+
+#include <stdbool.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "gl_hash_map.h"
+#include "gl_xmap.h"
+#include "xalloc.h"
+
+#include "manconfig.h"
+
+#include "debug.h"
+#include "filenames.h"
+#include "glcontainers.h"
+#include "intern.h"
+
+#include "db_snapshot.h"
+#include "db_storage.h"
+#include "mydbm.h"
+
+/* Append STR and its terminating NUL to the strings of SNAP, returning its
+ * offset.
+ */
+static size_t add_string (struct db_snapshot *snap, const char *str)
+{
+	size_t len = strlen (str) + 1;
+	size_t offset = snap->strings_len;
+
+	while (snap->strings_len + len > snap->strings_max)
+		snap->strings = x2nrealloc (snap->strings, &snap->strings_max,
+		                            1);
+	memcpy (snap->strings + offset, str, len);
+	snap->strings_len += len;
+	return offset;
+}
+
+/* State needed only while loading a snapshot. */
+struct snapshot_load {
+	size_t rows_max;
+	/* Shared description keys, mapped to the offsets of their text. */
+	gl_map_t shared;
+	/* Rows whose whatis fields refer to shared descriptions. */
+	size_t *refs;
+	size_t nrefs, refs_max;
+};
+
+static void add_shared (struct db_snapshot *snap, struct snapshot_load *load,
+                        const char *key, const char *cont)
+{
+	size_t *offset = XMALLOC (size_t);
+
+	*offset = add_string (snap, cont);
+	gl_map_put (load->shared, xstrdup (key), offset);
+}
+
+static void add_row (struct db_snapshot *snap, struct snapshot_load *load,
+                     MYDBM_FILE dbf, const char *key, const char *cont)
+{
+	size_t row = snap->count;
+	size_t key_offset, cont_offset;
+	char *tab, *start[FIELDS];
+	int i;
+
+	if (row == load->rows_max) {
+		size_t new_max = load->rows_max;
+
+		snap->ids = x2nrealloc (snap->ids, &new_max, 1);
+		snap->shared_whatis = xnrealloc (snap->shared_whatis, new_max,
+		                                 sizeof *snap->shared_whatis);
+		snap->mtimes = xnrealloc (snap->mtimes, new_max,
+		                          sizeof *snap->mtimes);
+		for (i = 0; i < SNAPSHOT_COLUMNS; ++i)
+			snap->columns[i] =
+			        xnrealloc (snap->columns[i], new_max,
+			                   sizeof *snap->columns[i]);
+		load->rows_max = new_max;
+	}
+
+	key_offset = add_string (snap, key);
+	tab = strrchr (snap->strings + key_offset, '\t');
+	if (tab && tab != snap->strings + key_offset)
+		*tab = '\0';
+
+	/* Split the content in place.  The fields then stay put as the
+	 * strings grow, since they are only ever referred to by offset.
+	 */
+	cont_offset = add_string (snap, cont);
+	split_data (dbf, snap->strings + cont_offset, start);
+
+#define OFFSET(ptr) ((size_t) ((ptr) - snap->strings))
+	snap->columns[SNAPSHOT_KEY][row] = key_offset;
+	snap->columns[SNAPSHOT_NAME][row] = OFFSET (start[0]);
+	snap->columns[SNAPSHOT_EXT][row] = OFFSET (start[1]);
+	snap->columns[SNAPSHOT_SEC][row] = OFFSET (start[2]);
+	snap->mtimes[row].tv_sec = (time_t) atol (start[3]);
+	snap->mtimes[row].tv_nsec = atol (start[4]);
+	snap->ids[row] = *start[5];
+	snap->columns[SNAPSHOT_POINTER][row] = OFFSET (start[6]);
+	snap->columns[SNAPSHOT_FILTER][row] = OFFSET (start[7]);
+	snap->columns[SNAPSHOT_COMP][row] = OFFSET (start[8]);
+	snap->columns[SNAPSHOT_WHATIS][row] =
+	        OFFSET (whatis_field_text (start[9]));
+#undef OFFSET
+	snap->shared_whatis[row] = false;
+
+	/* Shared descriptions may come later in the database, so these are
+	 * resolved once it has all been read.
+	 */
+	if (is_whatis_reference (start[9])) {
+		if (load->nrefs == load->refs_max)
+			load->refs = x2nrealloc (load->refs, &load->refs_max,
+			                         sizeof *load->refs);
+		load->refs[load->nrefs++] = row;
+	}
+
+	++snap->count;
+}
+
+/* Point the rows that refer to shared descriptions at their text, or at
+ * an empty string if it is missing.
+ */
+static void resolve_shared (struct db_snapshot *snap,
+                            struct snapshot_load *load)
+{
+	size_t *whatis = snap->columns[SNAPSHOT_WHATIS];
+	size_t i;
+
+	for (i = 0; i < load->nrefs; ++i) {
+		size_t row = load->refs[i];
+		const char *ref = snap->strings + whatis[row];
+		const size_t *offset = gl_map_get (load->shared, ref);
+
+		if (offset) {
+			whatis[row] = *offset;
+			snap->shared_whatis[row] = true;
+		} else {
+			debug ("shared description %s missing\n", ref);
+			whatis[row] += strlen (ref);
+		}
+	}
+}
+
+/* Read every page entry in DBF.  Identifier keys and the multi-key entries
+ * that group several pages under one name are skipped, just as callers
+ * walking the database themselves would skip them.  Shared descriptions
+ * are filled in to the entries that refer to them.
+ */
+struct db_snapshot *db_snapshot_load (MYDBM_FILE dbf)
+{
+	struct db_snapshot *snap = XZALLOC (struct db_snapshot);
+	struct snapshot_load load;
+	datum key, cont;
+#ifndef BTREE
+	datum nextkey;
+#else  /* BTREE */
+	int end;
+#endif /* !BTREE */
+
+	memset (&load, 0, sizeof load);
+	load.shared = new_string_map (GL_HASH_MAP, plain_free);
+
+#ifndef BTREE
+	key = MYDBM_FIRSTKEY (dbf);
+	while (MYDBM_DPTR (key)) {
+		cont = MYDBM_FETCH (dbf, key);
+#else  /* BTREE */
+	end = man_btree_nextkeydata (dbf, &key, &cont);
+	while (!end) {
+#endif /* !BTREE */
+		if (!MYDBM_DPTR (cont)) {
+			debug ("key was %s\n", MYDBM_DPTR (key));
+			gripe_corrupt_data (dbf);
+		}
+
+#pragma GCC diagnostic push
+#if GNUC_PREREQ(10, 0)
+#  pragma GCC diagnostic ignored "-Wanalyzer-use-after-free"
+#endif
+		if (STRNEQ (MYDBM_DPTR (key), WHATIS_STRING_PREFIX,
+		            sizeof WHATIS_STRING_PREFIX - 1))
+			add_shared (snap, &load, MYDBM_DPTR (key),
+			            MYDBM_DPTR (cont));
+		else if (*MYDBM_DPTR (key) != '$' &&
+		         *MYDBM_DPTR (cont) != '\t')
+			add_row (snap, &load, dbf, MYDBM_DPTR (key),
+			         MYDBM_DPTR (cont));
+#pragma GCC diagnostic pop
+
+#pragma GCC diagnostic push
+#if GNUC_PREREQ(10, 0)
+#  pragma GCC diagnostic ignored "-Wanalyzer-double-free"
+#endif
+#ifndef BTREE
+		nextkey = MYDBM_NEXTKEY (dbf, key);
+		MYDBM_FREE_DPTR (cont);
+		MYDBM_FREE_DPTR (key);
+		key = nextkey;
+#else  /* BTREE */
+		MYDBM_FREE_DPTR (cont);
+		MYDBM_FREE_DPTR (key);
+		end = man_btree_nextkeydata (dbf, &key, &cont);
+#endif /* !BTREE */
+#pragma GCC diagnostic pop
+	}
+
+	resolve_shared (snap, &load);
+	debug ("snapshot of %s: %zu pages, %zu shared descriptions, "
+	       "%zu bytes of strings\n",
+	       dbf->name, snap->count, gl_map_size (load.shared),
+	       snap->strings_len);
+	free (load.refs);
+	gl_map_free (load.shared);
+	return snap;
+}
+
+void db_snapshot_free (struct db_snapshot *snap)
+{
+	int i;
+
+	if (!snap)
+		return;
+	for (i = 0; i < SNAPSHOT_COLUMNS; ++i)
+		free (snap->columns[i]);
+	free (snap->ids);
+	free (snap->shared_whatis);
+	free (snap->mtimes);
+	free (snap->strings);
+	free (snap);
+}
+
+const char *db_snapshot_string (const struct db_snapshot *snap,
+                                enum db_snapshot_column column, size_t row)
+{
+	return snap->strings + snap->columns[column][row];
+}
+
+void db_snapshot_row (const struct db_snapshot *snap, size_t row,
+                      struct mandata *info)
+{
+#define FIELD(column) db_snapshot_string (snap, column, row)
+	memset (info, 0, sizeof *info);
+	info->name = (char *) FIELD (SNAPSHOT_NAME);
+	if (STREQ (info->name, "-"))
+		info->name = NULL;
+	info->ext = intern_string (FIELD (SNAPSHOT_EXT));
+	info->sec = intern_string (FIELD (SNAPSHOT_SEC));
+	info->mtime = snap->mtimes[row];
+	info->id = snap->ids[row];
+	info->pointer = (char *) FIELD (SNAPSHOT_POINTER);
+	info->filter = intern_string (FIELD (SNAPSHOT_FILTER));
+	info->comp = intern_string (FIELD (SNAPSHOT_COMP));
+	info->whatis = (char *) FIELD (SNAPSHOT_WHATIS);
+#undef FIELD
+}
+
+size_t *db_snapshot_rows (const struct db_snapshot *snap)
+{
+	size_t *rows = XNMALLOC (snap->count ? snap->count : 1, size_t);
+	size_t i;
+
+	for (i = 0; i < snap->count; ++i)
+		rows[i] = i;
+	return rows;
+}
+
+size_t db_snapshot_filter (const struct db_snapshot *snap, size_t *rows,
+                           size_t nrows, db_snapshot_predicate predicate,
+                           void *data)
+{
+	size_t i, kept = 0;
+
+	for (i = 0; i < nrows; ++i)
+		if (predicate (snap, rows[i], data))
+			rows[kept++] = rows[i];
+	return kept;
+}
+
+size_t db_snapshot_scan (const struct db_snapshot *snap, size_t *rows,
+                         size_t nrows, enum db_snapshot_column column,
+                         const char *value, char id)
+{
+	const size_t *offsets = snap->columns[column];
+	size_t i, kept = 0;
+
+	for (i = 0; i < nrows; ++i) {
+		size_t row = rows[i];
+
+		if (id && snap->ids[row] != id)
+			continue;
+		if (STREQ (snap->strings + offsets[row], value))
+			rows[kept++] = row;
+	}
+	return kept;
+}
+
+/* qsort has no context argument. */
+static const struct db_snapshot *sort_snap;
+static const size_t *sort_offsets;
+
+static int row_compare (const void *a, const void *b)
+{
+	size_t left = *(const size_t *) a, right = *(const size_t *) b;
+	int cmp = strcmp (sort_snap->strings + sort_offsets[left],
+	                  sort_snap->strings + sort_offsets[right]);
+
+	if (cmp)
+		return cmp;
+	return (left > right) - (left < right);
+}
+
+void db_snapshot_sort (const struct db_snapshot *snap, size_t *rows,
+                       size_t nrows, enum db_snapshot_column column)
+{
+	sort_snap = snap;
+	sort_offsets = snap->columns[column];
+	qsort (rows, nrows, sizeof *rows, row_compare);
+	sort_snap = NULL;
+	sort_offsets = NULL;
+}
@@ -0,0 +1,112 @@
+/*
+ * db_snapshot.h: interface to columnar database snapshots
+ *
+ * Copyright (C) 2024 Colin Watson.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ */
+
+#ifndef DB_SNAPSHOT_H
+#define DB_SNAPSHOT_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <time.h>
+
+#include "filenames.h"
+
+#include "mydbm.h"
+
+/* String columns of a snapshot.  SNAPSHOT_KEY is the database key with
+ * any trailing extension removed; the others correspond to the fields of
+ * struct mandata, and hold "-" where the field is unset.
+ */
+enum db_snapshot_column {
+	SNAPSHOT_KEY,
+	SNAPSHOT_NAME,
+	SNAPSHOT_EXT,
+	SNAPSHOT_SEC,
+	SNAPSHOT_POINTER,
+	SNAPSHOT_FILTER,
+	SNAPSHOT_COMP,
+	SNAPSHOT_WHATIS,
+	SNAPSHOT_COLUMNS
+};
+
+/* A read-only copy of every page entry in a database, taken in a single
+ * pass.  Each string column is an array of offsets into one block of
+ * strings, so that scanning a column touches only the data it needs and
+ * the whole snapshot costs a handful of allocations.
+ *
+ * Descriptions that the database shares between several entries are
+ * copied once, and the SNAPSHOT_WHATIS column of all those entries has
+ * the same offset; SHARED_WHATIS is true for them.
+ */
+struct db_snapshot {
+	size_t count;
+	size_t *columns[SNAPSHOT_COLUMNS];
+	char *ids;
+	bool *shared_whatis;
+	struct timespec *mtimes;
+	char *strings;
+	size_t strings_len, strings_max;
+};
+
+/* A predicate for db_snapshot_filter. */
+typedef bool (*db_snapshot_predicate) (const struct db_snapshot *snap,
+                                       size_t row, void *data);
+
+extern struct db_snapshot *db_snapshot_load (MYDBM_FILE dbf);
+extern void db_snapshot_free (struct db_snapshot *snap);
+
+/* Return the string in COLUMN of ROW. */
+extern const char *db_snapshot_string (const struct db_snapshot *snap,
+                                       enum db_snapshot_column column,
+                                       size_t row);
+
+/* Fill in INFO from ROW.  Its name, pointer, and whatis point into SNAP,
+ * and must not be freed or modified.
+ */
+extern void db_snapshot_row (const struct db_snapshot *snap, size_t row,
+                             struct mandata *info);
+
+/* Return a newly-allocated array of the indices of all rows, in database
+ * order.
+ */
+extern size_t *db_snapshot_rows (const struct db_snapshot *snap);
+
+/* Keep only those of the NROWS indices in ROWS for which PREDICATE returns
+ * true, preserving their order.  Returns the number kept.
+ */
+extern size_t db_snapshot_filter (const struct db_snapshot *snap,
+                                  size_t *rows, size_t nrows,
+                                  db_snapshot_predicate predicate,
+                                  void *data);
+
+/* Keep only those of the NROWS indices in ROWS whose COLUMN is equal to
+ * VALUE and, unless ID is zero, whose ID is equal to ID.  Returns the
+ * number kept.
+ */
+extern size_t db_snapshot_scan (const struct db_snapshot *snap, size_t *rows,
+                                size_t nrows, enum db_snapshot_column column,
+                                const char *value, char id);
+
+/* Sort the NROWS indices in ROWS by COLUMN, keeping database order among
+ * equal strings.
+ */
+extern void db_snapshot_sort (const struct db_snapshot *snap, size_t *rows,
+                              size_t nrows, enum db_snapshot_column column);
+
+#endif /* DB_SNAPSHOT_H */
@@ -49,6 +49,15 @@
 
 #define FIELDS 10 /* No of fields in each database page `content' */
 
+/* A whatis description shared by several entries is stored once, under a
+ * key made of WHATIS_STRING_PREFIX and eight hexadecimal digits, and the
+ * whatis fields of those entries hold that key in its place.  So that
+ * descriptions can't be mistaken for references, a description stored in
+ * place that starts with '$' has another '$' put in front of it.
+ */
+#define WHATIS_STRING_PREFIX "$whatis$"
+#define WHATIS_REFERENCE_LEN (sizeof WHATIS_STRING_PREFIX - 1 + 8)
+
 #include "filenames.h"
 
 #include "mydbm.h"
@@ -70,12 +79,17 @@ extern int dbstore (MYDBM_FILE dbf, struct mandata *in, const char *base);
 extern int dbdelete (MYDBM_FILE dbf, const char *name, struct mandata *in);
 extern void dbprintf (const struct mandata *info);
 extern struct mandata *split_content (MYDBM_FILE dbf, char *cont_ptr);
+extern char *dbstore_whatis (MYDBM_FILE dbf, const char *whatis);
+extern char *dbfetch_whatis (MYDBM_FILE dbf, const char *ref);
+extern bool is_whatis_reference (const char *whatis);
+extern const char *whatis_field_text (const char *field);
 extern int compare_ids (char a, char b, bool promote_links);
 
 /* local to db routines */
 extern void gripe_lock (const char *filename);
 extern void gripe_corrupt_data (MYDBM_FILE dbf);
 extern datum make_multi_key (const char *page, const char *ext);
+extern char **split_data (MYDBM_FILE dbf, char *content, char *start[]);
 
 extern char *name_to_key (const char *name);
 bool name_ext_equals (const void *elt1, const void *elt2);
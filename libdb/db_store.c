@@ -36,6 +36,7 @@
 #include "error.h"
 #include "gl_array_list.h"
 #include "gl_xlist.h"
+#include "hash-pjw-bare.h"
 #include "timespec.h"
 #include "xalloc.h"
 #include "xvasprintf.h"
@@ -123,17 +124,19 @@ static int replace_if_necessary (MYDBM_FILE dbf, struct mandata *newdata,
 	} else if (compare_ids (newdata->id, olddata->id, false) > 0) {
 		debug ("replace_if_necessary: weaker ID; not replacing\n");
 		action = REPLACE_NO;
-	} else if (newdata->pointer && olddata->pointer &&
-	           strcmp (newdata->pointer, olddata->pointer) < 0) {
+	} else if (strcmp (dash_if_unset (newdata->pointer),
+	                   dash_if_unset (olddata->pointer)) < 0) {
 		debug ("replace_if_necessary: pointer '%s' < '%s'; "
 		       "replacing\n",
-		       newdata->pointer, olddata->pointer);
+		       dash_if_unset (newdata->pointer),
+		       dash_if_unset (olddata->pointer));
 		action = REPLACE_YES;
-	} else if (newdata->pointer && olddata->pointer &&
-	           strcmp (newdata->pointer, olddata->pointer) > 0) {
+	} else if (strcmp (dash_if_unset (newdata->pointer),
+	                   dash_if_unset (olddata->pointer)) > 0) {
 		debug ("replace_if_necessary: pointer '%s' > '%s'; "
 		       "not replacing\n",
-		       newdata->pointer, olddata->pointer);
+		       dash_if_unset (newdata->pointer),
+		       dash_if_unset (olddata->pointer));
 		action = REPLACE_NO;
 	} else if (!STREQ (dash_if_unset (newdata->comp), olddata->comp)) {
 		debug ("replace_if_necessary: differing compression "
@@ -159,29 +162,32 @@ static int replace_if_necessary (MYDBM_FILE dbf, struct mandata *newdata,
 	}
 }
 
-/* The complement of split_content */
-static datum make_content (struct mandata *in)
+/* The complement of split_content.  Unset fields are stored as "-",
+ * except for the whatis, which is stored as an empty string; IN itself is
+ * left alone, so its strings may be borrowed.
+ */
+static datum make_content (const struct mandata *in)
 {
 	datum cont;
-	static const char dash[] = "-";
+	const char *whatis, *escape = "";
 	char *value;
 
 	memset (&cont, 0, sizeof cont);
 
-	if (!in->pointer)
-		in->pointer = xstrdup (dash);
-	if (!in->comp)
-		in->comp = xstrdup (dash);
-	if (!in->filter)
-		in->filter = xstrdup (dash);
-	if (!in->whatis)
-		in->whatis = xstrdup (dash + 1);
+	if (in->whatis_ref)
+		whatis = in->whatis_ref;
+	else {
+		whatis = in->whatis ? in->whatis : "";
+		if (*whatis == '$')
+			escape = "$";
+	}
 
-	value = xasprintf ("%s\t%s\t%s\t%ld\t%ld\t%c\t%s\t%s\t%s\t%s",
+	value = xasprintf ("%s\t%s\t%s\t%ld\t%ld\t%c\t%s\t%s\t%s\t%s%s",
 	                   dash_if_unset (in->name), in->ext, in->sec,
 	                   (long) in->mtime.tv_sec, (long) in->mtime.tv_nsec,
-	                   in->id, in->pointer, in->filter, in->comp,
-	                   in->whatis);
+	                   in->id, dash_if_unset (in->pointer),
+	                   dash_if_unset (in->filter),
+	                   dash_if_unset (in->comp), escape, whatis);
 	assert (value);
 	MYDBM_SET (cont, value);
 
@@ -216,6 +222,64 @@ static char *make_extensions_reference (gl_list_t refs)
 	return data;
 }
 
+/* Store WHATIS once as a shared description, unless an identical one is
+ * already stored, and return the reference that entries sharing it should
+ * hold in their whatis fields.  The key is derived from the text, so that
+ * pages indexed separately with the same description find the same one;
+ * collisions are resolved by trying the next few keys.  Returns NULL if
+ * WHATIS is too short to be worth sharing or no free key could be found,
+ * in which case the entries should hold WHATIS itself.
+ */
+char *dbstore_whatis (MYDBM_FILE dbf, const char *whatis)
+{
+	size_t len = strlen (whatis);
+	unsigned long hash;
+	int probe;
+
+	if (len <= WHATIS_REFERENCE_LEN)
+		return NULL;
+
+	hash = hash_pjw_bare (whatis, len);
+	for (probe = 0; probe < 8; ++probe) {
+		datum key, cont;
+		char *ref;
+
+		ref = xasprintf ("%s%08lx", WHATIS_STRING_PREFIX,
+		                 (hash + probe) & 0xffffffffUL);
+		memset (&key, 0, sizeof key);
+		MYDBM_SET (key, xstrdup (ref));
+		cont = MYDBM_FETCH (dbf, key);
+
+		if (!MYDBM_DPTR (cont)) {
+			memset (&cont, 0, sizeof cont);
+			MYDBM_SET (cont, xstrdup (whatis));
+			if (MYDBM_INSERT (dbf, key, cont)) {
+				MYDBM_FREE_DPTR (cont);
+				MYDBM_FREE_DPTR (key);
+				free (ref);
+				return NULL;
+			}
+			debug ("stored shared description %s\n", ref);
+			MYDBM_FREE_DPTR (cont);
+			MYDBM_FREE_DPTR (key);
+			return ref;
+		}
+
+		if (STREQ (MYDBM_DPTR (cont), whatis)) {
+			MYDBM_FREE_DPTR (cont);
+			MYDBM_FREE_DPTR (key);
+			return ref;
+		}
+
+		debug ("shared description %s collides\n", ref);
+		MYDBM_FREE_DPTR (cont);
+		MYDBM_FREE_DPTR (key);
+		free (ref);
+	}
+
+	return NULL;
+}
+
 /*
  Any one of three situations can occur when storing some data.
 
@@ -201,6 +201,15 @@ extern struct timespec man_btree_get_time (man_btree_wrapper wrap);
 		MYDBM_SET_DPTR (d, NULL);                                     \
 	} while (0)
 
+/* db_cache.c */
+/* Open DATABASE read-only, reusing the handle from an earlier call if the
+ * database has not been replaced or modified since.  Returns NULL on
+ * failure.  The handle belongs to the cache and must not be freed.
+ */
+extern MYDBM_FILE dbcache_open (const char *database);
+/* Close all handles opened by dbcache_open. */
+extern void dbcache_close_all (void);
+
 /* db_lookup.c */
 extern datum copy_datum (datum dat);
 
@@ -0,0 +1,18 @@
+# man-liburing.m4 serial 1
+dnl MAN_LIBURING
+dnl Add a --without-liburing option; check for the liburing library.
+AC_DEFUN([MAN_LIBURING],
+	[AC_ARG_WITH([liburing],
+		[AS_HELP_STRING([--without-liburing],
+				[do not use io_uring to batch file status requests])],
+		[],
+		[with_liburing=check])
+	if test "x$with_liburing" != "xno"; then
+		PKG_CHECK_MODULES([liburing], [liburing],
+			[AC_DEFINE([HAVE_LIBURING], [1],
+				[Define to 1 if you have the `liburing' library.])],
+			[if test "x$with_liburing" = "xyes"; then
+				AC_MSG_ERROR([--with-liburing given but cannot find liburing])
+			 fi])
+	fi
+]) # MAN_LIBURING
@@ -49,6 +49,7 @@
 #include "fatal.h"
 #include "util.h"
 
+#include "db_storage.h"
 #include "mydbm.h"
 
 static const char *cat_root;
@@ -110,6 +111,21 @@ static char *help_filter (int key, const char *text, void *input MAYBE_UNUSED)
 
 static struct argp argp = {options, parse_opt, args_doc, doc, 0, help_filter};
 
+/* Return the whatis field of the page entry CONTENT, or NULL if there is
+ * none.
+ */
+static char *whatis_field (char *content)
+{
+	int i;
+
+	for (i = 0; content && i < FIELDS - 1; ++i) {
+		content = strchr (content, '\t');
+		if (content)
+			++content;
+	}
+	return content;
+}
+
 int main (int argc, char *argv[])
 {
 	MYDBM_FILE dbf;
@@ -141,7 +157,7 @@ int main (int argc, char *argv[])
 
 	while (MYDBM_DPTR (key) != NULL) {
 		datum content, nextkey;
-		char *t, *nicekey;
+		char *t, *nicekey, *whatis = NULL;
 
 		content = MYDBM_FETCH (dbf, key);
 		if (!MYDBM_DPTR (content)) {
@@ -152,9 +168,24 @@ int main (int argc, char *argv[])
 		nicekey = xstrdup (MYDBM_DPTR (key));
 		while ((t = strchr (nicekey, '\t')))
 			*t = '~';
+		/* Show shared descriptions in the entries that use them,
+		 * and other descriptions without their escapes, so that the
+		 * output describes the same pages however they happen to be
+		 * stored.
+		 */
+		t = NULL;
+		if (*MYDBM_DPTR (key) != '$' && *MYDBM_DPTR (content) != '\t')
+			t = whatis_field (MYDBM_DPTR (content));
+		if (t && is_whatis_reference (t)) {
+			whatis = dbfetch_whatis (dbf, t);
+			*t = '\0';
+		} else if (t && whatis_field_text (t) != t)
+			memmove (t, t + 1, strlen (t));
 		while ((t = strchr (MYDBM_DPTR (content), '\t')))
 			*t = ' ';
-		printf ("%s -> \"%s\"\n", nicekey, MYDBM_DPTR (content));
+		printf ("%s -> \"%s%s\"\n", nicekey, MYDBM_DPTR (content),
+		        whatis ? whatis : "");
+		free (whatis);
 		free (nicekey);
 #pragma GCC diagnostic push
 #if GNUC_PREREQ(10, 0)
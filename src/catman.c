@@ -31,7 +31,6 @@
 #  include "config.h"
 #endif /* HAVE_CONFIG_H */
 
-#include <assert.h>
 #include <errno.h>
 #include <limits.h>
 #include <stdbool.h>
@@ -83,6 +82,7 @@
 #include "pipeline.h"
 #include "util.h"
 
+#include "db_snapshot.h"
 #include "db_storage.h"
 #include "mydbm.h"
 
@@ -200,39 +200,27 @@ static void catman (pipecmd *cmd)
 		       _ ("man command failed with exit status %d"), status);
 }
 
-/* Add key to this command, stripping off tab-and-following if necessary.
- * Return length of argument.
- */
-static size_t add_arg (pipecmd *cmd, datum key)
+/* Add key to this command.  Return length of argument. */
+static size_t add_arg (pipecmd *cmd, const char *key)
 {
-	char *tab;
 	size_t len;
 
-	tab = strrchr (MYDBM_DPTR (key), '\t');
-	if (tab == MYDBM_DPTR (key))
-		tab = NULL;
-
-	if (tab)
-		*tab = '\0';
-	pipecmd_arg (cmd, MYDBM_DPTR (key));
-	len = strlen (MYDBM_DPTR (key));
-	debug ("key: '%s' (%zu), len: %zu\n", MYDBM_DPTR (key),
-	       (size_t) MYDBM_DSIZE (key), len);
-	if (tab)
-		*tab = '\t';
+	pipecmd_arg (cmd, key);
+	len = strlen (key);
+	debug ("key: '%s', len: %zu\n", key, len);
 
 	return len;
 }
 
 /* find all pages that are in the supplied manpath and section and that are
    ultimate source files. */
-static int parse_for_sec (MYDBM_FILE dbf, const char *manpath,
+static int parse_for_sec (const struct db_snapshot *snap, const char *manpath,
                           const char *section)
 {
 	pipecmd *basecmd, *cmd;
-	datum key;
 	size_t arg_size, initial_bit;
-	bool message = true;
+	size_t *rows, nrows, i;
+	const char *prev_key = NULL;
 	int first_arg;
 
 	basecmd = pipecmd_new (MAN);
@@ -256,84 +244,47 @@ static int parse_for_sec (MYDBM_FILE dbf, const char *manpath,
 	first_arg = pipecmd_get_nargs (cmd);
 
 	arg_size = initial_bit;
-	key = MYDBM_FIRSTKEY (dbf);
-
-	while (MYDBM_DPTR (key) != NULL) {
-		datum nextkey;
-
-		/* ignore db identifier keys */
-#pragma GCC diagnostic push
-#if GNUC_PREREQ(10, 0)
-#  pragma GCC diagnostic ignored "-Wanalyzer-use-after-free"
-#endif
-		if (*MYDBM_DPTR (key) != '$') {
-#pragma GCC diagnostic pop
-			datum content;
-
-			content = MYDBM_FETCH (dbf, key);
-
-			if (!MYDBM_DPTR (content))
-				fatal (0, _ ("NULL content for key: %s"),
-				       MYDBM_DPTR (key));
-
-				/* ignore overflow entries */
-#pragma GCC diagnostic push
-#if GNUC_PREREQ(10, 0)
-#  pragma GCC diagnostic ignored "-Wanalyzer-use-after-free"
-#endif
-			if (*MYDBM_DPTR (content) != '\t') {
-#pragma GCC diagnostic pop
-				struct mandata *entry;
-
-				entry = split_content (dbf,
-				                       MYDBM_DPTR (content));
-
-				/* Accept if the entry is an ultimate manual
-				   page and the section matches the one we're
-				   currently dealing with */
-				if (entry->id == ULT_MAN &&
-				    strcmp (entry->sec, section) == 0) {
-					if (message) {
-						printf (_ ("\nUpdating cat "
-						           "files for section "
-						           "%s of man "
-						           "hierarchy %s\n"),
-						        section, manpath);
-						message = false;
-					}
-
-					arg_size += add_arg (cmd, key) + 1;
-
-					debug ("arg space free: %zu bytes\n",
-					       ARG_MAX - arg_size);
-
-					/* Check to see if we have enough room
-					   to add another max sized filename
-					   and that we haven't run out of array
-					   space too */
-					if (arg_size >= ARG_MAX - NAME_MAX ||
-					    pipecmd_get_nargs (cmd) ==
-					            MAX_ARGS) {
-						catman (cmd);
-
-						cmd = pipecmd_dup (basecmd);
-						arg_size = initial_bit;
-					}
-				}
-
-				free_mandata_struct (entry);
-			}
 
-			/* we don't need the content ever again */
-			assert (MYDBM_DPTR (content)); /* just to be sure */
-			MYDBM_FREE_DPTR (content);
+	/* Accept if the entry is an ultimate manual page and the section
+	   matches the one we're currently dealing with.  Sorting by name
+	   lets us pass each name to man only once, since -a formats every
+	   page of that name in the section anyway. */
+	rows = db_snapshot_rows (snap);
+	nrows = db_snapshot_scan (snap, rows, snap->count, SNAPSHOT_SEC,
+	                          section, ULT_MAN);
+	db_snapshot_sort (snap, rows, nrows, SNAPSHOT_KEY);
+
+	if (nrows)
+		printf (_ ("\nUpdating cat files for section %s of man "
+		           "hierarchy %s\n"),
+		        section, manpath);
+
+	for (i = 0; i < nrows; ++i) {
+		const char *key = db_snapshot_string (snap, SNAPSHOT_KEY,
+		                                      rows[i]);
+
+		if (prev_key && STREQ (key, prev_key))
+			continue;
+		prev_key = key;
+
+		arg_size += add_arg (cmd, key) + 1;
+
+		debug ("arg space free: %zu bytes\n", ARG_MAX - arg_size);
+
+		/* Check to see if we have enough room to add another max
+		   sized filename and that we haven't run out of array space
+		   too */
+		if (arg_size >= ARG_MAX - NAME_MAX ||
+		    pipecmd_get_nargs (cmd) == MAX_ARGS) {
+			catman (cmd);
+
+			cmd = pipecmd_dup (basecmd);
+			arg_size = initial_bit;
 		}
-
-		nextkey = MYDBM_NEXTKEY (dbf, key);
-		MYDBM_FREE_DPTR (key);
-		key = nextkey;
 	}
 
+	free (rows);
+
 	if (pipecmd_get_nargs (cmd) > first_arg)
 		catman (cmd);
 	else
@@ -396,6 +347,7 @@ int main (int argc, char *argv[])
 	GL_LIST_FOREACH (manpathlist, mp) {
 		char *catpath, *database;
 		MYDBM_FILE dbf;
+		struct db_snapshot *snap;
 		size_t len;
 
 		catpath = get_catpath (mp, SYSTEM_CAT | USER_CAT);
@@ -421,6 +373,7 @@ int main (int argc, char *argv[])
 		dbf_close_post_fork = dbf;
 
 		len = strlen (catpath);
+		snap = NULL;
 
 		for (sp = sections; sp && *sp; sp++) {
 			*(catpath + len) = '\0';
@@ -429,12 +382,17 @@ int main (int argc, char *argv[])
 				continue;
 			if (check_access (catpath))
 				continue;
-			if (parse_for_sec (dbf, mp, *sp)) {
+			/* Read the database once for all sections. */
+			if (!snap)
+				snap = db_snapshot_load (dbf);
+			if (parse_for_sec (snap, mp, *sp)) {
 				error (0, 0, _ ("unable to update %s"), mp);
 				break;
 			}
 		}
 
+		db_snapshot_free (snap);
+
 next:
 		dbf_close_post_fork = NULL;
 		MYDBM_FREE (dbf);
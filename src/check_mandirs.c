@@ -49,8 +49,10 @@
 #include "error.h"
 #include "gl_array_list.h"
 #include "gl_hash_map.h"
+#include "gl_hash_set.h"
 #include "gl_xlist.h"
 #include "gl_xmap.h"
+#include "gl_xset.h"
 #include "stat-time.h"
 #include "timespec.h"
 #include "xalloc.h"
@@ -62,11 +64,14 @@
 #include "manconfig.h"
 
 #include "appendstr.h"
+#include "arena.h"
 #include "compression.h"
 #include "debug.h"
+#include "dirstats.h"
 #include "fatal.h"
 #include "filenames.h"
 #include "glcontainers.h"
+#include "intern.h"
 #include "orderfiles.h"
 #include "security.h"
 #include "util.h"
@@ -80,6 +85,8 @@
 #include "lexgrog.h"
 #include "manp.h"
 #include "ult_src.h"
+#include "ult_store.h"
+#include "whatis_cache.h"
 
 bool opt_test; /* don't update db */
 int pages;
@@ -87,6 +94,9 @@ bool force_rescan = false;
 
 static gl_map_t whatis_map = NULL;
 
+/* Temporaries made while indexing a single page, released once it is done. */
+static struct arena *page_arena = NULL;
+
 struct whatis {
 	char *whatis;
 	char *filters;
@@ -147,50 +157,37 @@ static bool ensure_db_open (MYDBM_FILE dbf)
 	return true;
 }
 
-/* Take absolute filename and path (for ult_src) and do sanity checks on
- * file. Also check that file is non-zero in length and is not already in
- * the db. If not, find its ult_src() and see if we have the whatis cached,
- * otherwise cache it in case we trace another manpage back to it. Next,
- * store it in the db along with any references found in the whatis.
- */
-void test_manfile (MYDBM_FILE dbf, const char *file, const char *path)
+static void index_page (MYDBM_FILE dbf, const char *file, const char *path,
+                        const struct stat *lst)
 {
-	char *manpage_base;
+	const char *manpage_base;
 	const struct ult_value *ult;
-	struct lexgrog lg;
 	struct mandata *info, *exists;
-	struct compression *comp;
 	struct stat buf;
 	size_t len;
 	const struct whatis *whatis;
 
 	debug ("\ntest_manfile: considering %s\n", file);
 
-	memset (&lg, 0, sizeof (struct lexgrog));
-
-	info = filename_info (file, quiet < 2);
+	info = filename_info_arena (file, quiet < 2, page_arena);
 	if (!info)
 		return;
-	manpage_base = info->name; /* steal memory */
-	info->name = NULL;
-
-	comp = comp_info (file, true);
-	if (comp) {
-		len = strlen (comp->stem);
-		free (comp->stem);
-	} else
+	manpage_base = info->name;
+
+	if (!comp_info_len (file, &len))
 		len = strlen (file);
 
 	/* to get mtime info */
-	(void) lstat (file, &buf);
+	if (lst)
+		buf = *lst;
+	else
+		(void) lstat (file, &buf);
 	info->mtime = get_stat_mtime (&buf);
 
 	/* check that our file actually contains some data */
-	if (buf.st_size == 0) {
+	if (buf.st_size == 0)
 		/* man-db pre 2.3 place holder ? */
-		free_mandata_struct (info);
 		return;
-	}
 
 	/* Check for multiple pages whose details match except for having
 	 * different compression extensions.
@@ -211,7 +208,6 @@ void test_manfile (MYDBM_FILE dbf, const char *file, const char *path)
 			                        manpage_base, exists->ext);
 			free (abs_filename);
 			free_mandata_struct (exists);
-			free_mandata_struct (info);
 			return;
 		}
 	}
@@ -221,7 +217,14 @@ void test_manfile (MYDBM_FILE dbf, const char *file, const char *path)
 	 * looking for whatis info in files containing only '.so
 	 * manx/foo.x', which will give us an unobtainable whatis
 	 * for the entry. */
-	ult = ult_src (file, path, &buf, SO_LINK | SOFT_LINK | HARD_LINK);
+	ult = ult_store_lookup (dbf, file, SO_LINK | SOFT_LINK | HARD_LINK);
+	if (!ult) {
+		ult = ult_src (file, path, &buf,
+		               SO_LINK | SOFT_LINK | HARD_LINK);
+		if (ult && !opt_test)
+			ult_store_save (dbf, file,
+			                SO_LINK | SOFT_LINK | HARD_LINK, ult);
+	}
 
 	if (!ult) {
 		if (quiet < 2)
@@ -229,7 +232,6 @@ void test_manfile (MYDBM_FILE dbf, const char *file, const char *path)
 			       _ ("warning: %s: bad symlink or ROFF `.so' "
 			          "request"),
 			       file);
-		free_mandata_struct (info);
 		return;
 	}
 
@@ -252,44 +254,68 @@ void test_manfile (MYDBM_FILE dbf, const char *file, const char *path)
 		whatis_map = new_string_map (GL_HASH_MAP, whatis_free);
 
 	whatis = gl_map_get (whatis_map, ult->path);
-	if (whatis) {
-		lg.whatis = whatis->whatis ? xstrdup (whatis->whatis) : NULL;
-		lg.filters =
-		        whatis->filters ? xstrdup (whatis->filters) : NULL;
-	} else {
-		/* Cache miss; go and get the whatis info in its raw state. */
-		char *file_base = base_name (file);
+	if (!whatis) {
+		struct stat ult_buf;
+		bool have_ult_buf = stat (ult->path, &ult_buf) == 0;
+		struct lexgrog lg;
 		struct whatis *new_whatis;
 
-		if (!STRNEQ (ult->path, file, len))
-			debug ("test_manfile: link not in cache:\n"
-			       " source = %s\n"
-			       " target = %s\n",
-			       file, ult->path);
+		memset (&lg, 0, sizeof (struct lexgrog));
+		if (have_ult_buf && whatis_cache_lookup (&ult_buf, &lg.whatis,
+		                                         &lg.filters))
+			debug ("test_manfile: %s unchanged since whatis "
+			       "cached\n",
+			       ult->path);
+		else {
+			/* Cache miss; go and get the whatis info in its raw
+			 * state.
+			 */
+			const char *file_base = last_component (file);
+
+			if (!STRNEQ (ult->path, file, len))
+				debug ("test_manfile: link not in cache:\n"
+				       " source = %s\n"
+				       " target = %s\n",
+				       file, ult->path);
+
+			lg.type = MANPAGE;
+			drop_effective_privs ();
+			find_name (ult->path, file_base, &lg, NULL);
+			regain_effective_privs ();
 
-		lg.type = MANPAGE;
-		drop_effective_privs ();
-		find_name (ult->path, file_base, &lg, NULL);
-		free (file_base);
-		regain_effective_privs ();
+			if (have_ult_buf)
+				whatis_cache_add (ult->path, &ult_buf,
+				                  lg.whatis, lg.filters);
+		}
 
+		/* The whatis map keeps these for any other page traced back
+		 * to the same source, so they outlive this page.
+		 */
 		new_whatis = XMALLOC (struct whatis);
-		new_whatis->whatis = lg.whatis ? xstrdup (lg.whatis) : NULL;
-		new_whatis->filters = lg.filters ? xstrdup (lg.filters) : NULL;
+		new_whatis->whatis = lg.whatis;
+		new_whatis->filters = lg.filters;
 		gl_map_put (whatis_map, xstrdup (ult->path), new_whatis);
+		whatis = new_whatis;
 	}
 
-	debug ("\"%s\"\n", lg.whatis);
+	debug ("\"%s\"\n", whatis->whatis);
 
 	/* split up the raw whatis data and store references */
 	info->pointer = NULL; /* direct page, so far */
-	info->filter = lg.filters;
-	if (lg.whatis) {
-		gl_list_t descs = parse_descriptions (manpage_base, lg.whatis);
+	info->filter = intern_string (whatis->filters);
+	if (whatis->whatis) {
+		char *whatis_text;
+		struct page_description *descs;
+		size_t ndescs;
+
+		/* parse_descriptions splits up its own copy. */
+		whatis_text = arena_strdup (page_arena, whatis->whatis);
+		descs = parse_descriptions (manpage_base, whatis_text,
+		                            page_arena, &ndescs);
 		if (!opt_test)
-			store_descriptions (dbf, descs, info, path,
-			                    manpage_base, ult->trace);
-		gl_list_free (descs);
+			store_descriptions (dbf, descs, ndescs, info, path,
+			                    manpage_base, ult->trace,
+			                    page_arena);
 	} else if (quiet < 2) {
 		(void) stat (ult->path, &buf);
 		if (buf.st_size == 0)
@@ -301,9 +327,32 @@ void test_manfile (MYDBM_FILE dbf, const char *file, const char *path)
 			          "failed"),
 			       ult->path, manpage_base, info->ext);
 	}
+}
 
-	free_mandata_struct (info);
-	free (lg.whatis);
+/* Take absolute filename and path (for ult_src) and do sanity checks on
+ * file. Also check that file is non-zero in length and is not already in
+ * the db. If not, find its ult_src() and see if we have the whatis cached,
+ * otherwise cache it in case we trace another manpage back to it. Next,
+ * store it in the db along with any references found in the whatis.
+ * If LST is not NULL, it is the result of calling lstat on file.
+ */
+void test_manfile (MYDBM_FILE dbf, const char *file, const char *path,
+                   const struct stat *lst)
+{
+	if (!page_arena)
+		page_arena = arena_new ();
+
+	index_page (dbf, file, path, lst);
+
+	if (debug_level) {
+		struct arena_stats stats;
+
+		arena_get_stats (page_arena, &stats);
+		debug ("test_manfile: %zu scratch allocations (%zu bytes) "
+		       "from %zu new arena blocks\n",
+		       stats.allocations, stats.bytes, stats.blocks);
+	}
+	arena_reset (page_arena);
 }
 
 static void add_dir_entries (MYDBM_FILE dbf, const char *path, char *infile)
@@ -314,6 +363,9 @@ static void add_dir_entries (MYDBM_FILE dbf, const char *path, char *infile)
 	DIR *dir;
 	gl_list_t names;
 	const char *name;
+	struct ult_dir *udir;
+	struct dir_stats *stats;
+	struct file_order *order;
 
 	manpage = xasprintf ("%s/%s/", path, infile);
 	assert (manpage);
@@ -333,9 +385,17 @@ static void add_dir_entries (MYDBM_FILE dbf, const char *path, char *infile)
 
 	names = new_string_list (GL_ARRAY_LIST, false);
 
+	/* Note inode numbers as we go, so that resolving hard links
+	 * doesn't need to read the directory again for each page.
+	 */
+	manpage[len - 1] = '\0';
+	udir = ult_dir_new (manpage);
+	manpage[len - 1] = '/';
+
 	/* strlen(newdir->d_name) could be replaced by newdir->d_reclen */
 
 	while ((newdir = readdir (dir)) != NULL) {
+		ult_dir_add (udir, newdir->d_name, newdir->d_ino);
 		if (*newdir->d_name == '.' &&
 		    strlen (newdir->d_name) < (size_t) 3)
 			continue;
@@ -343,14 +403,25 @@ static void add_dir_entries (MYDBM_FILE dbf, const char *path, char *infile)
 	}
 	closedir (dir);
 
-	order_files (infile, &names);
+	order = order_files (infile, &names);
+
+	/* Ask for the status of everything in the directory up front if
+	 * that can be done in a batch.
+	 */
+	stats = dir_stats_new (infile, names);
 
 	GL_LIST_FOREACH (names, name) {
+		struct stat st;
+
+		order_files_next (order);
 		manpage = appendstr (manpage, name, nullptr);
-		test_manfile (dbf, manpage, path);
+		test_manfile (dbf, manpage, path,
+		              dir_stats_get (stats, name, &st) ? &st : NULL);
 		*(manpage + len) = '\0';
 	}
 
+	dir_stats_free (stats);
+	order_files_free (order);
 	gl_list_free (names);
 	free (manpage);
 }
@@ -733,6 +804,112 @@ pointers_next:
 	}
 }
 
+/* The pages under one tree of a hierarchy, indexed by name and extension
+ * so that purging the database doesn't have to search the tree once per
+ * entry.
+ */
+struct page_index {
+	const char *hier;
+	bool cat;
+	gl_map_t pages; /* "name\text" -> list of file names */
+};
+
+static void page_list_free (const void *value)
+{
+	gl_list_free ((gl_list_t) value);
+}
+
+/* Read each section directory under INDEX->HIER once, and file everything
+ * in them under the name and extension that look_for_file() would find
+ * them by.
+ */
+static void index_pages (struct page_index *index)
+{
+	gl_list_t dirs, files;
+	const char *dir, *file;
+	bool save_debug = debug_level;
+
+	index->pages = new_string_map (GL_HASH_MAP, page_list_free);
+
+	debug_level = false; /* match_in_directory() is quite noisy */
+	dirs = new_string_list (GL_ARRAY_LIST, false);
+	match_in_directory (index->hier, index->cat ? "cat?*" : "man?*",
+	                    LFF_MATCHCASE, dirs);
+	files = new_string_list (GL_ARRAY_LIST, false);
+	GL_LIST_FOREACH (dirs, dir)
+		match_in_directory (dir, "*", LFF_MATCHCASE, files);
+	debug_level = save_debug;
+
+	GL_LIST_FOREACH (files, file) {
+		struct mandata *info;
+		char *key;
+		gl_list_t paths;
+
+		info = filename_info (file, false);
+		if (!info)
+			continue;
+		key = xasprintf ("%s\t%s", info->name, info->ext);
+		paths = (gl_list_t) gl_map_get (index->pages, key);
+		if (paths)
+			free (key);
+		else {
+			paths = new_string_list (GL_ARRAY_LIST, false);
+			gl_map_put (index->pages, key, paths);
+		}
+		gl_list_add_last (paths, xstrdup (file));
+		free_mandata_struct (info);
+	}
+
+	debug ("indexed %zu files in %zu directories under %s\n",
+	       gl_list_size (files), gl_list_size (dirs), index->hier);
+	gl_list_free (files);
+	gl_list_free (dirs);
+}
+
+/* Equivalent to look_for_file (INDEX->HIER, EXT, NAME, INDEX->CAT,
+ * LFF_MATCHCASE), but answered from the index where possible.
+ */
+static gl_list_t find_pages (struct page_index *index, const char *name,
+                             const char *ext)
+{
+	int layout = get_mandir_layout ();
+	gl_list_t found;
+
+	if (layout & LAYOUT_GNU) {
+		gl_list_t paths;
+		const char *path;
+		char *key;
+
+		if (!index->pages)
+			index_pages (index);
+		key = xasprintf ("%s\t%s", name, ext);
+		paths = (gl_list_t) gl_map_get (index->pages, key);
+		free (key);
+
+		found = new_string_list (GL_ARRAY_LIST, false);
+		if (paths) {
+			GL_LIST_FOREACH (paths, path)
+				gl_list_add_last (found, xstrdup (path));
+		}
+		/* Other layouts are only tried if there are no GNU-style
+		 * matches.
+		 */
+		if (gl_list_size (found) || !(layout & ~LAYOUT_GNU))
+			return found;
+		gl_list_free (found);
+	}
+
+	{
+		bool save_debug = debug_level;
+
+		debug_level = false; /* look_for_file() is quite noisy */
+		found = look_for_file (index->hier, ext, name, index->cat,
+		                       LFF_MATCHCASE);
+		debug_level = save_debug;
+	}
+	return found;
+}
+
 /* Count the number of exact extension matches returned from look_for_file()
  * (which may return inexact extension matches in some cases). It may turn
  * out that this is better handled in look_for_file() itself.
@@ -798,7 +975,7 @@ static int purge_normal (MYDBM_FILE dbf, const char *name,
 }
 
 /* Decide whether to purge a reference to a WHATIS_MAN or WHATIS_CAT page. */
-static int purge_whatis (MYDBM_FILE dbf, const char *path, bool cat,
+static int purge_whatis (MYDBM_FILE dbf, struct page_index *index,
                          const char *name, struct mandata *info,
                          gl_list_t found, struct timespec db_mtime)
 {
@@ -841,14 +1018,10 @@ static int purge_whatis (MYDBM_FILE dbf, const char *path, bool cat,
 	} else {
 		/* Does the real page still exist? */
 		gl_list_t real_found;
-		bool save_debug = debug_level;
 		struct timespec t;
 		int count;
 
-		debug_level = false;
-		real_found = look_for_file (path, info->ext, info->pointer,
-		                            cat, LFF_MATCHCASE);
-		debug_level = save_debug;
+		real_found = find_pages (index, info->pointer, info->ext);
 
 		t.tv_sec = -1;
 		t.tv_nsec = -1;
@@ -907,6 +1080,64 @@ static bool check_multi_key (const char *name, const char *content)
 	return false;
 }
 
+/* Remove shared descriptions that no entry refers to any more. */
+static void purge_shared_whatis (MYDBM_FILE dbf)
+{
+	gl_list_t shared;
+	gl_set_t referenced;
+	datum key;
+	const char *ref;
+
+	shared = new_string_list (GL_ARRAY_LIST, false);
+	referenced = new_string_set (GL_HASH_SET);
+
+	key = MYDBM_FIRSTKEY (dbf);
+	while (MYDBM_DPTR (key) != NULL) {
+		datum content, nextkey;
+
+		if (is_whatis_reference (MYDBM_DPTR (key)))
+			gl_list_add_last (shared, xstrdup (MYDBM_DPTR (key)));
+		else if (*MYDBM_DPTR (key) != '$') {
+			content = MYDBM_FETCH (dbf, key);
+			if (MYDBM_DPTR (content) &&
+			    *MYDBM_DPTR (content) != '\t') {
+				char *start[FIELDS];
+
+				split_data (dbf, MYDBM_DPTR (content), start);
+				ref = start[FIELDS - 1];
+				if (is_whatis_reference (ref) &&
+				    !gl_set_search (referenced, ref))
+					gl_set_add (referenced, xstrdup (ref));
+			}
+			MYDBM_FREE_DPTR (content);
+		}
+
+		nextkey = MYDBM_NEXTKEY (dbf, key);
+		MYDBM_FREE_DPTR (key);
+		key = nextkey;
+	}
+
+	GL_LIST_FOREACH (shared, ref) {
+		datum unused;
+
+		if (gl_set_search (referenced, ref))
+			continue;
+		if (opt_test) {
+			debug ("%s: unused shared description, would delete\n",
+			       ref);
+			continue;
+		}
+		debug ("Removing unused shared description %s\n", ref);
+		memset (&unused, 0, sizeof unused);
+		MYDBM_SET (unused, xstrdup (ref));
+		MYDBM_DELETE (dbf, unused);
+		MYDBM_FREE_DPTR (unused);
+	}
+
+	gl_set_free (referenced);
+	gl_list_free (shared);
+}
+
 /* Go through the database and purge references to man pages that no longer
  * exist.
  */
@@ -920,6 +1151,8 @@ int purge_missing (MYDBM_FILE dbf, const char *manpath, const char *catpath)
 	datum key;
 	int count = 0;
 	struct timespec db_mtime;
+	struct page_index man_index = { manpath, false, NULL };
+	struct page_index cat_index = { catpath, true, NULL };
 
 #ifdef NDBM
 	dirfile = xasprintf ("%s.dir", dbf->name);
@@ -948,15 +1181,21 @@ int purge_missing (MYDBM_FILE dbf, const char *manpath, const char *catpath)
 		datum content, nextkey;
 		struct mandata *entry;
 		char *nicekey, *tab;
-		bool save_debug;
 		gl_list_t found;
 
 #pragma GCC diagnostic push
 #if GNUC_PREREQ(10, 0)
 #  pragma GCC diagnostic ignored "-Wanalyzer-use-after-free"
 #endif
-		/* Ignore db identifier keys. */
+		/* Ignore db identifier keys, but drop stored link
+		 * resolutions for files that have gone away.
+		 */
 		if (*MYDBM_DPTR (key) == '$') {
+			if (!opt_test &&
+			    ult_store_orphaned (MYDBM_DPTR (key))) {
+				debug ("Removing stale %s\n", MYDBM_DPTR (key));
+				MYDBM_DELETE (dbf, key);
+			}
 			nextkey = MYDBM_NEXTKEY (dbf, key);
 			MYDBM_FREE_DPTR (key);
 			key = nextkey;
@@ -997,19 +1236,10 @@ int purge_missing (MYDBM_FILE dbf, const char *manpath, const char *catpath)
 
 		entry = split_content (dbf, MYDBM_DPTR (content));
 
-		save_debug = debug_level;
-		debug_level = false; /* look_for_file() is quite noisy */
-		if (entry->id <= WHATIS_MAN)
-			found = look_for_file (manpath, entry->ext,
-			                       entry->name ? entry->name
-			                                   : nicekey,
-			                       false, LFF_MATCHCASE);
-		else
-			found = look_for_file (catpath, entry->ext,
-			                       entry->name ? entry->name
-			                                   : nicekey,
-			                       true, LFF_MATCHCASE);
-		debug_level = save_debug;
+		found = find_pages (entry->id <= WHATIS_MAN ? &man_index
+		                                            : &cat_index,
+		                    entry->name ? entry->name : nicekey,
+		                    entry->ext);
 
 		/* Now actually decide whether to purge, depending on the
 		 * type of entry.
@@ -1018,10 +1248,10 @@ int purge_missing (MYDBM_FILE dbf, const char *manpath, const char *catpath)
 		    entry->id == STRAY_CAT)
 			count += purge_normal (dbf, nicekey, entry, found);
 		else if (entry->id == WHATIS_MAN)
-			count += purge_whatis (dbf, manpath, false, nicekey,
+			count += purge_whatis (dbf, &man_index, nicekey,
 			                       entry, found, db_mtime);
 		else /* entry->id == WHATIS_CAT */
-			count += purge_whatis (dbf, catpath, true, nicekey,
+			count += purge_whatis (dbf, &cat_index, nicekey,
 			                       entry, found, db_mtime);
 
 		gl_list_free (found);
@@ -1034,5 +1264,12 @@ int purge_missing (MYDBM_FILE dbf, const char *manpath, const char *catpath)
 		key = nextkey;
 	}
 
+	if (man_index.pages)
+		gl_map_free (man_index.pages);
+	if (cat_index.pages)
+		gl_map_free (cat_index.pages);
+
+	purge_shared_whatis (dbf);
+
 	return count;
 }
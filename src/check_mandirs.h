@@ -21,6 +21,7 @@
  */
 
 #include <stdbool.h>
+#include <sys/stat.h>
 
 #include "mydbm.h"
 
@@ -29,7 +30,8 @@ extern bool opt_test;
 extern int pages;
 extern bool force_rescan;
 
-extern void test_manfile (MYDBM_FILE dbf, const char *file, const char *path);
+extern void test_manfile (MYDBM_FILE dbf, const char *file, const char *path,
+                          const struct stat *lst);
 extern void chown_if_possible (const char *path);
 extern int create_db (MYDBM_FILE dbf, const char *manpath,
                       const char *catpath);
@@ -84,8 +84,6 @@ static decompress *decompress_new_pipeline (pipeline *p)
 	return d;
 }
 
-#ifdef HAVE_LIBZ
-
 /* Create a new in-process decompressor.  Takes ownership of buf. */
 static decompress *decompress_new_inprocess (char *buf, size_t len)
 {
@@ -100,6 +98,8 @@ static decompress *decompress_new_inprocess (char *buf, size_t len)
 	return d;
 }
 
+#ifdef HAVE_LIBZ
+
 static void decompress_zlib (void *data MAYBE_UNUSED)
 {
 	gzFile zlibfile;
@@ -255,6 +255,11 @@ got_pipeline:
 	return decompress_new_pipeline (p);
 }
 
+decompress *decompress_open_buffer (const char *buf, size_t len)
+{
+	return decompress_new_inprocess (xmemdup (buf, len), len);
+}
+
 decompress *decompress_fdopen (int fd)
 {
 	pipeline *p;
@@ -61,6 +61,12 @@ decompress *decompress_open (const char *filename, int flags);
  */
 decompress *decompress_fdopen (int fd);
 
+/* Open an in-process decompressor holding a copy of the len bytes at buf.
+ * This is useful for callers that keep their own cache of decompressed file
+ * contents.
+ */
+decompress *decompress_open_buffer (const char *buf, size_t len);
+
 /* Return true if and only if this is a pipeline-based decompressor. */
 bool decompress_is_pipeline (const decompress *d);
 
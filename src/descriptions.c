@@ -25,54 +25,63 @@
 #endif /* HAVE_CONFIG_H */
 
 #include <stdbool.h>
-#include <stdlib.h>
+#include <stddef.h>
 #include <string.h>
 
-#include "gl_array_list.h"
-#include "gl_xlist.h"
-#include "xalloc.h"
-#include "xstrndup.h"
-
 #include "manconfig.h"
 
+#include "arena.h"
 #include "debug.h"
-#include "util.h"
 
 #include "descriptions.h"
 
-/* Free a page description. */
-static void page_description_free (const void *value)
+/* Trim leading and trailing spaces from S in place. */
+static char *trim_in_place (char *s)
 {
-	struct page_description *desc = (struct page_description *) value;
-
-	free (desc->name);
-	free (desc->whatis);
-	free (desc);
+	size_t length;
+
+	while (*s == ' ')
+		++s;
+	length = strlen (s);
+	while (length && s[length - 1] == ' ')
+		--length;
+	s[length] = '\0';
+	return s;
 }
 
-/* Parse the description in a whatis line returned by find_name() into a
- * list of names and whatis descriptions.
+/* Parse the description in a whatis line returned by find_name() into an
+ * array of names and whatis descriptions, storing its length in *COUNT.
+ *
+ * This works in place: WHATIS is split up by overwriting separators with
+ * null characters, and the returned names and descriptions point into it,
+ * so it must outlive them.  Only the array itself (and a copy of BASE, if
+ * that has to be added) is allocated, from ARENA.
  */
-gl_list_t parse_descriptions (const char *base, const char *whatis)
+struct page_description *parse_descriptions (const char *base, char *whatis,
+                                             struct arena *arena,
+                                             size_t *count)
 {
-	const char *sep, *nextsep;
-	gl_list_t descs;
+	struct page_description *descs;
+	char *sep, *p;
+	size_t max = 2;
 	bool seen_base = false;
 
-	descs = gl_list_create_empty (GL_ARRAY_LIST, NULL, NULL,
-	                              page_description_free, true);
-
+	*count = 0;
 	if (!whatis)
-		return descs;
+		return NULL;
+
+	/* Every name is followed by a comma or ends a record, so this
+	 * bounds the number of descriptions, allowing one more for BASE.
+	 */
+	for (p = whatis; *p; ++p)
+		if (*p == ',' || *p == 0x11)
+			++max;
+	descs = arena_alloc (arena, max * sizeof *descs);
 
 	sep = whatis;
 
 	while (sep) {
-		char *record;
-		size_t length;
-		const char *dash;
-		char *names;
-		const char *token;
+		char *record, *nextsep, *dash, *desc_whatis, *token, *next;
 
 		/* Use a while loop so that we skip over things like the
 		 * result of double line breaks.
@@ -81,27 +90,25 @@ gl_list_t parse_descriptions (const char *base, const char *whatis)
 			++sep;
 		nextsep = strchr (sep, 0x11);
 
-		/* Get this record as a null-terminated string. */
+		/* Terminate this record. */
 		if (nextsep)
-			length = (size_t) (nextsep - sep);
-		else
-			length = strlen (sep);
-		if (length == 0)
+			*nextsep++ = '\0';
+		record = sep;
+		if (!*record)
 			break;
-
-		record = xstrndup (sep, length);
 		debug ("record = '%s'\n", record);
 
 		/* Split the record into name and whatis description. */
 		dash = strstr (record, " - ");
-		if (dash)
-			names = xstrndup (record, dash - record);
-		else if (!gl_list_size (descs))
+		if (dash) {
+			*dash = '\0';
+			desc_whatis = trim_in_place (dash + 3);
+		} else if (!*count)
 			/* Some pages have a NAME section with just the page
 			 * name and no whatis.  We might as well include
 			 * this.
 			 */
-			names = xstrdup (record);
+			desc_whatis = NULL;
 		else
 			/* Once at least one record has been seen, further
 			 * cases where there is no whatis usually amount to
@@ -112,51 +119,45 @@ gl_list_t parse_descriptions (const char *base, const char *whatis)
 			 */
 			goto next;
 
-		for (token = strtok (names, ","); token;
-		     token = strtok (NULL, ",")) {
-			char *name = trim_spaces (token);
-			struct page_description *desc;
+		for (token = record; token; token = next) {
+			char *comma = strchr (token, ',');
+			char *name;
+
+			if (comma) {
+				*comma = '\0';
+				next = comma + 1;
+			} else
+				next = NULL;
+			/* As with strtok, skip empty tokens. */
+			if (!*token)
+				continue;
 
 			/* Skip name tokens containing whitespace. They are
 			 * almost never useful as manual page names.
 			 */
-			if (strpbrk (name, " \t") != NULL) {
-				free (name);
+			name = trim_in_place (token);
+			if (strpbrk (name, " \t") != NULL)
 				continue;
-			}
 
-			/* Allocate new description node. */
-			desc = xmalloc (sizeof *desc);
-			desc->name = name; /* steal memory */
-			desc->whatis = dash ? trim_spaces (dash + 3) : NULL;
-			gl_list_add_last (descs, desc);
+			descs[*count].name = name;
+			descs[*count].whatis = desc_whatis;
+			++*count;
 
-			if (base && STREQ (base, desc->name))
+			if (base && STREQ (base, name))
 				seen_base = true;
 		}
 
-		free (names);
 next:
-		free (record);
-
 		sep = nextsep;
 	}
 
 	/* If it isn't there already, add the base name onto the returned
-	 * list.
+	 * array.
 	 */
 	if (base && !seen_base) {
-		struct page_description *desc = xmalloc (sizeof *desc);
-
-		desc->name = xstrdup (base);
-		desc->whatis = NULL;
-		if (gl_list_size (descs)) {
-			const struct page_description *first =
-			        gl_list_get_at (descs, 0);
-			if (first->whatis)
-				desc->whatis = xstrdup (first->whatis);
-		}
-		gl_list_add_last (descs, desc);
+		descs[*count].name = arena_strdup (arena, base);
+		descs[*count].whatis = *count ? descs[0].whatis : NULL;
+		++*count;
 	}
 
 	return descs;
@@ -31,8 +31,15 @@ struct page_description {
 	char *whatis;
 };
 
-/* Returns a list of struct page_description. */
-extern gl_list_t parse_descriptions (const char *base, const char *whatis);
-extern void store_descriptions (MYDBM_FILE dbf, gl_list_t descs,
-                                struct mandata *info, const char *path,
-                                const char *base, gl_list_t trace);
+struct arena;
+
+/* Returns an array of struct page_description, allocated from ARENA. */
+extern struct page_description *parse_descriptions (const char *base,
+                                                    char *whatis,
+                                                    struct arena *arena,
+                                                    size_t *count);
+extern void store_descriptions (MYDBM_FILE dbf,
+                                const struct page_description *descs,
+                                size_t count, struct mandata *info,
+                                const char *path, const char *base,
+                                gl_list_t trace, struct arena *arena);
@@ -38,15 +38,12 @@
 #define _(String) gettext (String)
 
 #include "error.h"
-#include "gl_array_list.h"
-#include "gl_hash_map.h"
 #include "gl_xlist.h"
-#include "gl_xmap.h"
 #include "stat-time.h"
-#include "xalloc.h"
 
 #include "manconfig.h"
 
+#include "arena.h"
 #include "debug.h"
 #include "filenames.h"
 #include "glcontainers.h"
@@ -73,65 +70,97 @@ static int is_prefix (const char *parent, const char *child)
 	        STRNEQ (child + strlen (parent), "/man", 4));
 }
 
-/* Take a list of descriptions returned by parse_descriptions() and store
- * it into the database.
+/* Is WHATIS the description of more than one of the COUNT entries in
+ * INFOS?  parse_descriptions() gives all the names in a record, and the
+ * base name if it adds that, the same whatis pointer, so there is no need
+ * to compare the text.
  */
-void store_descriptions (MYDBM_FILE dbf, gl_list_t descs, struct mandata *info,
-                         const char *path, const char *base, gl_list_t trace)
+static bool whatis_shared (const struct mandata *infos, size_t count,
+                           const char *whatis)
+{
+	size_t i, uses = 0;
+
+	for (i = 0; i < count; ++i)
+		if (infos[i].whatis == whatis && ++uses > 1)
+			return true;
+	return false;
+}
+
+/* Take an array of descriptions returned by parse_descriptions() and store
+ * it into the database.  Temporaries are allocated from ARENA.
+ */
+void store_descriptions (MYDBM_FILE dbf, const struct page_description *descs,
+                         size_t count, struct mandata *info, const char *path,
+                         const char *base, gl_list_t trace,
+                         struct arena *arena)
 {
-	const struct page_description *desc;
 	const char *trace_name;
-	gl_map_t trace_infos;
-	gl_list_t whatis_infos;
-	struct mandata *whatis_info;
+	const struct mandata **trace_infos;
+	struct mandata *real_infos = NULL, *whatis_infos = NULL;
+	const char **real_names = NULL;
+	size_t nreal_infos = 0, nwhatis_infos = 0, ntrace, i, j;
+	const char *shared_whatis = NULL;
+	char *shared_ref = NULL;
 	const struct mandata *pointer_info;
 
 	assert (trace);
 	assert (gl_list_size (trace) > 0);
 
-	if (gl_list_size (descs)) {
+	if (count) {
 		GL_LIST_FOREACH (trace, trace_name)
 			debug ("trace: '%s'\n", trace_name);
 	}
 
-	trace_infos = new_string_map (
-	        GL_HASH_MAP, (gl_mapvalue_dispose_fn) free_mandata_struct);
-	whatis_infos = gl_list_create_empty (
-	        GL_ARRAY_LIST, NULL, NULL,
-	        (gl_listelement_dispose_fn) free_mandata_struct, true);
-
+	/* TRACE_INFOS[j] describes the jth name in TRACE, or is NULL if
+	 * that name is bogus.
+	 */
+	ntrace = gl_list_size (trace);
+	trace_infos = arena_alloc (arena, ntrace * sizeof *trace_infos);
+	j = 0;
 	GL_LIST_FOREACH (trace, trace_name)
-		gl_map_put (trace_infos, xstrdup (trace_name),
-		            filename_info (trace_name, quiet < 2));
+		trace_infos[j++] =
+		        filename_info_arena (trace_name, quiet < 2, arena);
+
+	/* Entries that merely refer to another page have to wait until we
+	 * know what to point them at.  Like all the entries we store here,
+	 * they borrow their strings from DESCS and TRACE_INFOS rather than
+	 * copying them.  Entries for real pages wait too, until we know
+	 * which of them share a description.
+	 */
+	if (count) {
+		real_infos = arena_alloc (arena, count * sizeof *real_infos);
+		real_names = arena_alloc (arena, count * sizeof *real_names);
+		whatis_infos =
+		        arena_alloc (arena, count * sizeof *whatis_infos);
+	}
 
-	GL_LIST_FOREACH (descs, desc) {
+	for (i = 0; i < count; ++i) {
+		const struct page_description *desc = &descs[i];
+		struct mandata whatis_info;
 		/* Either it's the real thing or merely a reference. Get the
 		 * id and pointer right in either case.
 		 */
 		bool found_real_page = false;
 		bool found_external = false;
 
-		whatis_info = XZALLOC (struct mandata);
-		whatis_info->ext = xstrdup (info->ext);
-		whatis_info->sec = xstrdup (info->sec);
-		whatis_info->id = info->id;
-		if (info->comp)
-			whatis_info->comp = xstrdup (info->comp);
-		if (info->filter)
-			whatis_info->filter = xstrdup (info->filter);
-		if (desc->whatis)
-			whatis_info->whatis = xstrdup (desc->whatis);
-		whatis_info->mtime = info->mtime;
+		memset (&whatis_info, 0, sizeof whatis_info);
+		whatis_info.ext = info->ext;
+		whatis_info.sec = info->sec;
+		whatis_info.id = info->id;
+		whatis_info.comp = info->comp;
+		whatis_info.filter = info->filter;
+		whatis_info.whatis = desc->whatis;
+		whatis_info.mtime = info->mtime;
 
 		if (STREQ (base, desc->name))
 			found_real_page = true;
 		else {
+			j = 0;
 			GL_LIST_FOREACH (trace, trace_name) {
 				const struct mandata *trace_info;
 				struct stat st;
 
-				trace_info =
-				        gl_map_get (trace_infos, trace_name);
+				trace_info = trace_infos[j++];
 				if (!trace_info ||
 				    !STREQ (trace_info->name, desc->name))
 					continue;
@@ -143,28 +172,21 @@ void store_descriptions (MYDBM_FILE dbf, gl_list_t descs, struct mandata *info,
 					found_external = true;
 					break;
 				}
-				free (whatis_info->ext);
-				whatis_info->ext = xstrdup (trace_info->ext);
-				free (whatis_info->sec);
-				whatis_info->sec = xstrdup (trace_info->sec);
+				whatis_info.ext = trace_info->ext;
+				whatis_info.sec = trace_info->sec;
 				if (!gl_list_next_node (trace, trace_node)) {
 					if (info->id == SO_MAN)
-						whatis_info->id = ULT_MAN;
+						whatis_info.id = ULT_MAN;
 				} else {
 					if (info->id == ULT_MAN)
-						whatis_info->id = SO_MAN;
+						whatis_info.id = SO_MAN;
 				}
-				free (whatis_info->comp);
-				if (trace_info->comp)
-					whatis_info->comp =
-					        xstrdup (trace_info->comp);
-				else
-					whatis_info->comp = NULL;
+				whatis_info.comp = trace_info->comp;
 				if (lstat (trace_name, &st) == 0)
-					whatis_info->mtime =
+					whatis_info.mtime =
 					        get_stat_mtime (&st);
 				else
-					whatis_info->mtime = info->mtime;
+					whatis_info.mtime = info->mtime;
 				found_real_page = true;
 			}
 		}
@@ -173,34 +195,53 @@ void store_descriptions (MYDBM_FILE dbf, gl_list_t descs, struct mandata *info,
 			debug ("skipping '%s'; link outside manual "
 			       "hierarchy\n",
 			       desc->name);
-			free_mandata_struct (whatis_info);
 			continue;
 		}
 
 		if (!found_real_page) {
-			whatis_info->name = xstrdup (desc->name);
+			whatis_info.name = desc->name;
 			if (info->id < STRAY_CAT)
-				whatis_info->id = WHATIS_MAN;
+				whatis_info.id = WHATIS_MAN;
 			else
-				whatis_info->id = WHATIS_CAT;
+				whatis_info.id = WHATIS_CAT;
 			/* Don't waste space storing the whatis in the db
 			 * more than once.
 			 */
-			free (whatis_info->whatis);
-			whatis_info->whatis = NULL;
-			gl_list_add_last (whatis_infos, whatis_info);
+			whatis_info.whatis = NULL;
+			whatis_infos[nwhatis_infos++] = whatis_info;
 			continue;
 		}
 
-		debug ("name = '%s', ext = '%s', id = %c\n", desc->name,
-		       whatis_info->ext, whatis_info->id);
-		if (dbstore (dbf, whatis_info, desc->name) > 0) {
-			gripe_bad_store (base, whatis_info->ext);
-			free_mandata_struct (whatis_info);
-			goto out;
+		real_names[nreal_infos] = desc->name;
+		real_infos[nreal_infos++] = whatis_info;
+	}
+
+	for (i = 0; i < nreal_infos; ++i) {
+		struct mandata real_info = real_infos[i];
+
+		/* A description shared by several names on this page is
+		 * stored once, and each of their entries refers to it.
+		 * Entries that refer to another page don't store a
+		 * description, so they don't count.
+		 */
+		if (real_info.whatis && real_info.whatis != shared_whatis) {
+			free (shared_ref);
+			shared_ref = NULL;
+			shared_whatis = real_info.whatis;
+			if (whatis_shared (real_infos, nreal_infos,
+			                   shared_whatis))
+				shared_ref =
+				        dbstore_whatis (dbf, shared_whatis);
 		}
+		if (real_info.whatis && shared_ref)
+			real_info.whatis_ref = shared_ref;
 
-		free_mandata_struct (whatis_info);
+		debug ("name = '%s', ext = '%s', id = %c\n", real_names[i],
+		       real_info.ext, real_info.id);
+		if (dbstore (dbf, &real_info, real_names[i]) > 0) {
+			gripe_bad_store (base, real_info.ext);
+			goto out;
+		}
 	}
 
 	/* The pointer for a WHATIS_MAN or WHATIS_CAT entry should be the
@@ -212,37 +253,34 @@ void store_descriptions (MYDBM_FILE dbf, gl_list_t descs, struct mandata *info,
 	 * thus unusable.
 	 */
 	pointer_info = NULL;
-	GL_LIST_FOREACH (trace, trace_name) {
-		const struct mandata *trace_info;
+	for (j = 0; j < ntrace; ++j) {
+		const struct mandata *trace_info = trace_infos[j];
 
-		trace_info = gl_map_get (trace_infos, trace_name);
-		if (trace_info && STREQ (trace_info->sec, info->sec) &&
-		    STREQ (trace_info->ext, info->ext))
+		if (trace_info && trace_info->sec == info->sec &&
+		    trace_info->ext == info->ext)
 			pointer_info = trace_info;
 	}
 	assert (pointer_info);
 
-	GL_LIST_FOREACH (whatis_infos, whatis_info) {
-		char *name;
+	for (i = 0; i < nwhatis_infos; ++i) {
+		struct mandata *whatis_info = &whatis_infos[i];
+		const char *name;
 
+		/* dbstore requires the name to be unset. */
 		name = whatis_info->name;
 		whatis_info->name = NULL;
 
-		whatis_info->pointer = xstrdup (pointer_info->name);
+		whatis_info->pointer = pointer_info->name;
 
 		debug ("name = '%s', ext = '%s', id = %c, pointer = '%s'\n",
 		       name, whatis_info->ext, whatis_info->id,
 		       whatis_info->pointer);
 		if (dbstore (dbf, whatis_info, name) > 0) {
 			gripe_bad_store (base, whatis_info->ext);
-			free (name);
 			goto out;
 		}
-
-		free (name);
 	}
 
 out:
-	gl_list_free (whatis_infos);
-	gl_map_free (trace_infos);
+	free (shared_ref);
 }
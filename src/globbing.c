@@ -61,7 +61,7 @@
 const char *extension;
 static const char *mandir_layout = MANDIR_LAYOUT;
 
-static char *make_pattern (const char *name, const char *sec, int opts)
+char *make_pattern (const char *name, const char *sec, int opts)
 {
 	char *pattern;
 
@@ -85,12 +85,6 @@ static char *make_pattern (const char *name, const char *sec, int opts)
 	return pattern;
 }
 
-#define LAYOUT_GNU     1
-#define LAYOUT_HPUX    2
-#define LAYOUT_IRIX    4
-#define LAYOUT_SOLARIS 8
-#define LAYOUT_BSD     16
-
 static int parse_layout (const char *layout)
 {
 	if (!*layout)
@@ -120,19 +114,48 @@ static int parse_layout (const char *layout)
 	}
 }
 
+int get_mandir_layout (void)
+{
+	static int layout = -1;
+
+	if (layout == -1) {
+		layout = parse_layout (mandir_layout);
+		debug ("Layout is %s (%d)\n", mandir_layout, layout);
+	}
+
+	return layout;
+}
+
+/* Fold ASCII letters to lower case.  This is deliberately independent of
+ * the locale, so that folded keys can be compared with plain strcmp.
+ */
+static inline char fold_char (char c)
+{
+	return (c >= 'A' && c <= 'Z') ? c + ('a' - 'A') : c;
+}
+
+/* The names in a directory, sorted case-insensitively.  Each entry
+ * carries its name together with a copy folded to lower case, which is
+ * what the array is sorted on; both are stored one after another in a
+ * single block.
+ */
+struct dirent_name {
+	const char *name;
+	const char *folded;
+};
+
 struct dirent_names {
-	char **names;
-	size_t names_len, names_max;
+	struct dirent_name *names;
+	size_t names_len;
+	char *arena;
 };
 
 static void dirent_names_free (const void *value)
 {
 	struct dirent_names *cache = (struct dirent_names *) value;
-	size_t i;
 
-	for (i = 0; i < cache->names_len; ++i)
-		free (cache->names[i]);
 	free (cache->names);
+	free (cache->arena);
 	free (cache);
 }
 
@@ -140,9 +163,11 @@ static gl_map_t dirent_map = NULL;
 
 static int cache_compare (const void *a, const void *b)
 {
-	const char *left = *(const char **) a;
-	const char *right = *(const char **) b;
-	return strcasecmp (left, right);
+	const struct dirent_name *left = a;
+	const struct dirent_name *right = b;
+	int cmp = strcmp (left->folded, right->folded);
+
+	return cmp ? cmp : strcmp (left->name, right->name);
 }
 
 static struct dirent_names *update_directory_cache (const char *path)
@@ -150,6 +175,9 @@ static struct dirent_names *update_directory_cache (const char *path)
 	struct dirent_names *cache;
 	DIR *dir;
 	struct dirent *entry;
+	size_t *offsets, offsets_max = 1024;
+	size_t arena_len = 0, arena_max = 16384;
+	size_t i;
 
 	if (!dirent_map) {
 		dirent_map = new_string_map (GL_HASH_MAP, dirent_names_free);
@@ -173,19 +201,38 @@ static struct dirent_names *update_directory_cache (const char *path)
 
 	cache = XMALLOC (struct dirent_names);
 	cache->names_len = 0;
-	cache->names_max = 1024;
-	cache->names = XNMALLOC (cache->names_max, char *);
+	cache->arena = xmalloc (arena_max);
+	offsets = XNMALLOC (offsets_max, size_t);
 
-	/* Dump all the entries into cache->names, resizing if necessary. */
+	/* Dump all the entries into the arena, each followed by its folded
+	 * key, resizing if necessary.  The arena may move as it grows, so
+	 * remember offsets for now.
+	 */
 	for (entry = readdir (dir); entry; entry = readdir (dir)) {
-		if (cache->names_len >= cache->names_max) {
-			cache->names_max *= 2;
-			cache->names =
-			        xnrealloc (cache->names, cache->names_max,
-			                   sizeof (char *));
-		}
-		cache->names[cache->names_len++] = xstrdup (entry->d_name);
+		size_t size = strlen (entry->d_name) + 1;
+		char *name;
+
+		if (cache->names_len >= offsets_max)
+			offsets = x2nrealloc (offsets, &offsets_max,
+			                      sizeof *offsets);
+		while (arena_len + 2 * size > arena_max)
+			cache->arena = x2nrealloc (cache->arena, &arena_max, 1);
+		name = cache->arena + arena_len;
+		memcpy (name, entry->d_name, size);
+		for (i = 0; i < size; ++i)
+			name[size + i] = fold_char (name[i]);
+		offsets[cache->names_len++] = arena_len;
+		arena_len += 2 * size;
+	}
+
+	cache->names = XNMALLOC (cache->names_len, struct dirent_name);
+	for (i = 0; i < cache->names_len; ++i) {
+		char *name = cache->arena + offsets[i];
+
+		cache->names[i].name = name;
+		cache->names[i].folded = name + strlen (name) + 1;
 	}
+	free (offsets);
 
 	qsort (cache->names, cache->names_len, sizeof *cache->names,
 	       &cache_compare);
@@ -196,16 +243,203 @@ static struct dirent_names *update_directory_cache (const char *path)
 	return cache;
 }
 
-struct pattern_bsearch {
-	char *pattern;
-	size_t len;
+/* Find the range [*FIRST, *LAST) of names in CACHE whose folded keys start
+ * with the folded string PREFIX of length LEN.
+ */
+static void find_prefix (const struct dirent_names *cache, const char *prefix,
+                         size_t len, size_t *first, size_t *last)
+{
+	size_t lo = 0, hi = cache->names_len;
+
+	while (lo < hi) {
+		size_t mid = lo + (hi - lo) / 2;
+
+		if (strncmp (cache->names[mid].folded, prefix, len) < 0)
+			lo = mid + 1;
+		else
+			hi = mid;
+	}
+	*first = lo;
+
+	hi = cache->names_len;
+	while (lo < hi) {
+		size_t mid = lo + (hi - lo) / 2;
+
+		if (strncmp (cache->names[mid].folded, prefix, len) <= 0)
+			lo = mid + 1;
+		else
+			hi = mid;
+	}
+	*last = lo;
+}
+
+/* Return a pointer to the ']' that closes the bracket expression starting
+ * at P, or NULL if there isn't one.
+ */
+static const char *skip_bracket (const char *p)
+{
+	++p;
+	if (*p == '^')
+		++p;
+	if (*p == ']')
+		++p;
+	while (*p && *p != ']') {
+		if (*p == '[' && (p[1] == ':' || p[1] == '.' || p[1] == '=')) {
+			char close = p[1];
+
+			for (p += 2; *p && !(*p == close && p[1] == ']'); ++p)
+				;
+			if (!*p)
+				return NULL;
+			p += 2;
+		} else
+			++p;
+	}
+	return *p ? p : NULL;
+}
+
+struct literal_scan {
+	char *run;
+	size_t run_len;
+	bool in_prefix;
+	bool last_literal; /* the last character in run may be quantified */
+	char *prefix;
+	char *required;
+	size_t required_len;
 };
 
-static int pattern_compare (const void *a, const void *b)
+static void end_run (struct literal_scan *scan)
 {
-	const struct pattern_bsearch *key = a;
-	const char *memb = *(const char **) b;
-	return strncasecmp (key->pattern, memb, key->len);
+	if (scan->in_prefix && scan->run_len)
+		scan->prefix = xstrndup (scan->run, scan->run_len);
+	scan->in_prefix = false;
+	if (scan->run_len > scan->required_len) {
+		free (scan->required);
+		scan->required = xstrndup (scan->run, scan->run_len);
+		scan->required_len = scan->run_len;
+	}
+	scan->run_len = 0;
+	scan->last_literal = false;
+}
+
+/* Add the literal character C to the current run.  Non-ASCII characters
+ * may have case variants that fold_char doesn't know about, so they end
+ * the run instead.
+ */
+static void add_literal (struct literal_scan *scan, char c)
+{
+	if ((unsigned char) c >= 0x80) {
+		end_run (scan);
+		return;
+	}
+	scan->run[scan->run_len++] = fold_char (c);
+	scan->last_literal = true;
+}
+
+/* Find literal text that any string matching the extended regular
+ * expression PATTERN must contain, folded to lower case: *PREFIX is set
+ * to text that such a string must start with, and *REQUIRED to the
+ * longest run of text that it must contain somewhere.  Either may be set
+ * to NULL.  This is conservative: when in doubt, it finds less.
+ */
+static void regex_literals (const char *pattern, char **prefix,
+                            char **required)
+{
+	struct literal_scan scan;
+	const char *p;
+
+	*prefix = NULL;
+	*required = NULL;
+
+	/* Alternation at any level means that nothing is certain. */
+	for (p = pattern; *p; ++p) {
+		if (*p == '\\' && p[1])
+			++p;
+		else if (*p == '[') {
+			p = skip_bracket (p);
+			if (!p)
+				return;
+		} else if (*p == '|')
+			return;
+	}
+
+	memset (&scan, 0, sizeof scan);
+	scan.run = xmalloc (strlen (pattern) + 1);
+	scan.in_prefix = (*pattern == '^');
+
+	for (p = scan.in_prefix ? pattern + 1 : pattern; *p; ++p) {
+		switch (*p) {
+			case '\\':
+				if (!p[1])
+					end_run (&scan);
+				else if (CTYPE (isalnum, p[1]) ||
+				         strchr ("`'<>", p[1])) {
+					/* Back-references, and GNU
+					 * operators such as \w or \<.
+					 */
+					end_run (&scan);
+					++p;
+				} else
+					add_literal (&scan, *++p);
+				break;
+			case '*':
+			case '?':
+			case '{':
+				/* The preceding literal is optional. */
+				if (scan.last_literal)
+					--scan.run_len;
+				end_run (&scan);
+				if (*p == '{')
+					while (p[1] && *p != '}')
+						++p;
+				break;
+			case '[':
+				end_run (&scan);
+				p = skip_bracket (p);
+				if (!p)
+					goto out;
+				break;
+			case '(': {
+				/* Groups may be optional or repeated; skip
+				 * them entirely.
+				 */
+				int depth = 1;
+
+				end_run (&scan);
+				while (depth && *++p) {
+					if (*p == '\\' && p[1])
+						++p;
+					else if (*p == '[') {
+						p = skip_bracket (p);
+						if (!p)
+							goto out;
+					} else if (*p == '(')
+						++depth;
+					else if (*p == ')')
+						--depth;
+				}
+				if (!*p)
+					goto out;
+				break;
+			}
+			case '+':
+			case '.':
+			case '^':
+			case '$':
+			case ')':
+				end_run (&scan);
+				break;
+			default:
+				add_literal (&scan, *p);
+				break;
+		}
+	}
+
+out:
+	end_run (&scan);
+	free (scan.run);
+	*prefix = scan.prefix;
+	*required = scan.required;
 }
 
 static void match_regex_in_directory (const char *path, const char *pattern,
@@ -214,6 +448,8 @@ static void match_regex_in_directory (const char *path, const char *pattern,
 {
 	int flags;
 	regex_t preg;
+	char *prefix, *required;
+	size_t first = 0, last = cache->names_len;
 	size_t i;
 
 	debug ("matching regex in %s: %s\n", path, pattern);
@@ -223,16 +459,30 @@ static void match_regex_in_directory (const char *path, const char *pattern,
 
 	xregcomp (&preg, pattern, flags);
 
-	for (i = 0; i < cache->names_len; ++i) {
-		if (regexec (&preg, cache->names[i], 0, NULL, 0) != 0)
+	regex_literals (pattern, &prefix, &required);
+	if (prefix)
+		find_prefix (cache, prefix, strlen (prefix), &first, &last);
+	if (prefix || required)
+		debug ("regex literals: prefix '%s', required '%s'; "
+		       "%zu of %zu names to check\n",
+		       prefix ? prefix : "", required ? required : "",
+		       last - first, cache->names_len);
+
+	for (i = first; i < last; ++i) {
+		const char *name = cache->names[i].name;
+
+		if (required && !strstr (cache->names[i].folded, required))
+			continue;
+		if (regexec (&preg, name, 0, NULL, 0) != 0)
 			continue;
 
-		debug ("matched: %s/%s\n", path, cache->names[i]);
+		debug ("matched: %s/%s\n", path, name);
 
-		gl_list_add_last (matched,
-		                  xasprintf ("%s/%s", path, cache->names[i]));
+		gl_list_add_last (matched, xasprintf ("%s/%s", path, name));
 	}
 
+	free (required);
+	free (prefix);
 	regfree (&preg);
 }
 
@@ -241,48 +491,42 @@ static void match_wildcard_in_directory (const char *path, const char *pattern,
                                          struct dirent_names *cache)
 {
 	int flags;
-	struct pattern_bsearch pattern_start = {NULL, -1};
-	char **bsearched;
-	size_t i;
+	char *prefix;
+	size_t prefix_len, first, last, i;
 
 	debug ("matching wildcard in %s: %s\n", path, pattern);
 
 	flags = (opts & LFF_MATCHCASE) ? 0 : FNM_CASEFOLD;
 
-	pattern_start.pattern =
-	        xstrndup (pattern, strcspn (pattern, "?*{}\\"));
-	pattern_start.len = strlen (pattern_start.pattern);
-	bsearched = bsearch (&pattern_start, cache->names, cache->names_len,
-	                     sizeof *cache->names, &pattern_compare);
-	if (!bsearched) {
-		free (pattern_start.pattern);
-		return;
-	}
-	while (bsearched > cache->names &&
-	       !strncasecmp (pattern_start.pattern, *(bsearched - 1),
-	                     pattern_start.len))
-		--bsearched;
-
-	for (i = bsearched - cache->names; i < cache->names_len; ++i) {
-		assert (pattern_start.pattern);
-		if (strncasecmp (pattern_start.pattern, cache->names[i],
-		                 pattern_start.len))
+	/* Narrow down the names to consider using the literal text at the
+	 * start of the pattern.
+	 */
+	prefix_len = strcspn (pattern, "?*[{}\\");
+	prefix = xmalloc (prefix_len + 1);
+	for (i = 0; i < prefix_len; ++i) {
+		if ((unsigned char) pattern[i] >= 0x80)
 			break;
+		prefix[i] = fold_char (pattern[i]);
+	}
+	prefix_len = i;
+	prefix[prefix_len] = '\0';
+	find_prefix (cache, prefix, prefix_len, &first, &last);
+	free (prefix);
+
+	for (i = first; i < last; ++i) {
+		const char *name = cache->names[i].name;
 
-		if (fnmatch (pattern, cache->names[i], flags) != 0)
+		if (fnmatch (pattern, name, flags) != 0)
 			continue;
 
-		debug ("matched: %s/%s\n", path, cache->names[i]);
+		debug ("matched: %s/%s\n", path, name);
 
-		gl_list_add_last (matched,
-		                  xasprintf ("%s/%s", path, cache->names[i]));
+		gl_list_add_last (matched, xasprintf ("%s/%s", path, name));
 	}
-
-	free (pattern_start.pattern);
 }
 
-static void match_in_directory (const char *path, const char *pattern,
-                                int opts, gl_list_t matched)
+void match_in_directory (const char *path, const char *pattern, int opts,
+                         gl_list_t matched)
 {
 	struct dirent_names *cache;
 
@@ -304,7 +548,7 @@ gl_list_t look_for_file (const char *hier, const char *sec,
 {
 	gl_list_t matched;
 	char *pattern, *path = NULL;
-	static int layout = -1;
+	int layout;
 	char *name;
 
 	matched = new_string_list (GL_ARRAY_LIST, false);
@@ -312,10 +556,7 @@ gl_list_t look_for_file (const char *hier, const char *sec,
 	/* This routine only does a minimum amount of matching. It does not
 	   find cat files in the alternate cat directory. */
 
-	if (layout == -1) {
-		layout = parse_layout (mandir_layout);
-		debug ("Layout is %s (%d)\n", mandir_layout, layout);
-	}
+	layout = get_mandir_layout ();
 
 	if (opts & (LFF_REGEX | LFF_WILDCARD))
 		name = xstrdup (unesc_name);
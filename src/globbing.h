@@ -30,9 +30,29 @@ enum look_for_file_opts {
 	LFF_WILDCARD = 4
 };
 
+#define LAYOUT_GNU     1
+#define LAYOUT_HPUX    2
+#define LAYOUT_IRIX    4
+#define LAYOUT_SOLARIS 8
+#define LAYOUT_BSD     16
+
 /* globbing.c */
 extern const char *extension;
 
+/* Return the LAYOUT_* flags selected by MANDIR_LAYOUT. */
+extern int get_mandir_layout (void);
+
+/* Return the shell pattern (or regex, given LFF_REGEX) that look_for_file
+ * matches against file names for NAME in section SEC.
+ */
+extern char *make_pattern (const char *name, const char *sec, int opts);
+
+/* Add to MATCHED the full names of all files in directory PATH that match
+ * PATTERN, a shell pattern or (given LFF_REGEX) a regex.
+ */
+extern void match_in_directory (const char *path, const char *pattern,
+                                int opts, gl_list_t matched);
+
 extern gl_list_t look_for_file (const char *hier, const char *sec,
                                 const char *unesc_name, bool cat, int opts);
 
@@ -29,6 +29,7 @@
 #include <stdbool.h>
 #include <stdio.h>
 #include <stdlib.h>
+#include <time.h>
 
 #include "argp.h"
 #include "error.h"
@@ -36,6 +37,7 @@
 #include "progname.h"
 
 #include "gettext.h"
+#define _(String)  gettext (String)
 #define N_(String) gettext_noop (String)
 
 #include "manconfig.h"
@@ -49,6 +51,7 @@
 static bool match_case = false;
 static bool regex_opt = false;
 static bool wildcard = false;
+static unsigned long benchmark = 0;
 static char **remaining_args;
 
 const char *argp_program_version = "globbing " PACKAGE_VERSION;
@@ -66,6 +69,8 @@ static struct argp_option options[] = {
         OPT ("match-case", 'I', 0, N_ ("look for pages case-sensitively")),
         OPT ("regex", 'r', 0, N_ ("interpret page name as a regex")),
         OPT ("wildcard", 'w', 0, N_ ("the page name contains wildcards")),
+        OPT ("benchmark", 'b', N_ ("COUNT"),
+             N_ ("repeat the lookup COUNT times and report the rate")),
         OPT_HELP_COMPAT,
         {0}};
 
@@ -90,6 +95,15 @@ static error_t parse_opt (int key, char *arg, struct argp_state *state)
 		case 'w':
 			wildcard = true;
 			return 0;
+		case 'b': {
+			char *end;
+
+			benchmark = strtoul (arg, &end, 10);
+			if (!*arg || *end || !benchmark)
+				argp_error (state, _ ("invalid count: %s"),
+				            arg);
+			return 0;
+		}
 		case 'h':
 			argp_state_help (state, state->out_stream,
 			                 ARGP_HELP_STD_HELP);
@@ -108,9 +122,33 @@ static error_t parse_opt (int key, char *arg, struct argp_state *state)
 
 static struct argp argp = {options, parse_opt, args_doc};
 
+/* Time repeated lookups.  After the first, directory contents come from
+ * the in-process cache, so this measures the cost of matching.
+ */
+static void run_benchmark (int opts)
+{
+	struct timespec start, end;
+	unsigned long n;
+	double elapsed;
+
+	clock_gettime (CLOCK_MONOTONIC, &start);
+	for (n = 0; n < benchmark; ++n)
+		gl_list_free (look_for_file (remaining_args[0],
+		                             remaining_args[1],
+		                             remaining_args[2], (bool) (n & 1),
+		                             opts));
+	clock_gettime (CLOCK_MONOTONIC, &end);
+
+	elapsed = (double) (end.tv_sec - start.tv_sec) +
+	          (double) (end.tv_nsec - start.tv_nsec) / 1e9;
+	fprintf (stderr, "%lu lookups in %.3f seconds: %.0f lookups/sec\n",
+	         benchmark, elapsed, elapsed > 0 ? benchmark / elapsed : 0);
+}
+
 int main (int argc, char **argv)
 {
 	int i;
+	int opts;
 
 	set_program_name (argv[0]);
 
@@ -121,15 +159,20 @@ int main (int argc, char **argv)
 		exit (FAIL);
 	assert (remaining_args);
 
+	opts = (match_case ? LFF_MATCHCASE : 0) | (regex_opt ? LFF_REGEX : 0) |
+	       (wildcard ? LFF_WILDCARD : 0);
+
+	if (benchmark) {
+		run_benchmark (opts);
+		return 0;
+	}
+
 	for (i = 0; i <= 1; i++) {
 		gl_list_t files;
 		const char *file;
 
 		files = look_for_file (remaining_args[0], remaining_args[1],
-		                       remaining_args[2], (bool) i,
-		                       (match_case ? LFF_MATCHCASE : 0) |
-		                               (regex_opt ? LFF_REGEX : 0) |
-		                               (wildcard ? LFF_WILDCARD : 0));
+		                       remaining_args[2], (bool) i, opts);
 		GL_LIST_FOREACH (files, file)
 			printf ("%s\n", file);
 		gl_list_free (files);
@@ -36,7 +36,6 @@
 #include "argp.h"
 #include "attribute.h"
 #include "error.h"
-#include "gl_list.h"
 #include "progname.h"
 #include "xalloc.h"
 
@@ -46,9 +45,9 @@
 
 #include "manconfig.h"
 
+#include "arena.h"
 #include "cleanup.h"
 #include "debug.h"
-#include "glcontainers.h"
 #include "pipeline.h"
 #include "sandbox.h"
 #include "security.h"
@@ -158,6 +157,7 @@ int main (int argc, char **argv)
 	int type = MANPAGE;
 	int i;
 	bool some_failed = false;
+	struct arena *arena;
 
 	set_program_name (argv[0]);
 
@@ -179,6 +179,7 @@ int main (int argc, char **argv)
 	else
 		type = CATPAGE;
 
+	arena = arena_new ();
 	for (i = 0; i < num_files; ++i) {
 		lexgrog lg;
 		const char *file = NULL;
@@ -217,9 +218,12 @@ int main (int argc, char **argv)
 		}
 
 		if (file && find_name (file, "-", &lg, encoding)) {
-			gl_list_t descs = parse_descriptions (NULL, lg.whatis);
-			const struct page_description *desc;
-			GL_LIST_FOREACH (descs, desc) {
+			size_t ndescs, j;
+			struct page_description *descs = parse_descriptions (
+			        NULL, lg.whatis, arena, &ndescs);
+			for (j = 0; j < ndescs; ++j) {
+				const struct page_description *desc =
+				        &descs[j];
 				if (!desc->name || !desc->whatis)
 					continue;
 				found = true;
@@ -238,7 +242,7 @@ int main (int argc, char **argv)
 				}
 				printf ("\n");
 			}
-			gl_list_free (descs);
+			arena_reset (arena);
 			free (lg.filters);
 			free (lg.whatis);
 		}
@@ -249,6 +253,7 @@ int main (int argc, char **argv)
 		}
 	}
 
+	arena_free (arena);
 	sandbox_free (sandbox);
 
 	if (some_failed)
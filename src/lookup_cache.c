@@ -0,0 +1,765 @@
+/*
+ * lookup_cache.c: cache of page lookups, written by mandb
+ *
+ * Copyright (C) 2024 Colin Watson.
+ *
+ * This file is part of man-db.
+ *
+ * man-db is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * man-db is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with man-db; if not, write to the Free Software Foundation,
+ * Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ * The cache is a single native-endian file laid out as a header, an array
+ * of directories, an array of files sorted case-insensitively by name, an
+ * array of database keys sorted by strcmp, and a block of NUL-terminated
+ * strings that the other parts refer to by offset.  It is only trusted if
+ * the hierarchy and the database have the same modification times as when
+ * the cache was written.  Each man and cat directory is checked
+ * separately, by inode and modification time; man reads any directory
+ * that has changed as usual, and uses the cache for the rest.
+ */
+
+#ifdef HAVE_CONFIG_H
+#  include "config.h"
+#endif /* HAVE_CONFIG_H */
+
+#include <dirent.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/types.h>
+#include <unistd.h>
+
+#include "fnmatch.h"
+#include "gl_array_list.h"
+#include "gl_hash_set.h"
+#include "gl_xlist.h"
+#include "gl_xset.h"
+#include "stat-time.h"
+#include "timespec.h"
+#include "xalloc.h"
+#include "xstrndup.h"
+#include "xvasprintf.h"
+
+#include "manconfig.h"
+
+#include "debug.h"
+#include "glcontainers.h"
+#include "util.h"
+
+#include "db_storage.h"
+#include "mydbm.h"
+
+#include "globbing.h"
+#include "lookup_cache.h"
+
+#define LOOKUP_MAGIC   0x6d6c6b63 /* "mlkc" */
+#define LOOKUP_VERSION 2
+
+struct lookup_header {
+	uint32_t magic;
+	uint32_t version;
+	uint32_t hier; /* string offset */
+	uint32_t ndirs;
+	uint32_t nfiles;
+	uint32_t nkeys;
+	uint32_t strings_size;
+	uint32_t unused;
+	int64_t hier_sec, hier_nsec;
+	int64_t db_sec, db_nsec;
+};
+
+struct lookup_dir {
+	uint32_t name; /* string offset, relative to the hierarchy */
+	uint32_t unused;
+	int64_t mtime_sec, mtime_nsec;
+	uint64_t dev, ino;
+};
+
+struct lookup_file {
+	uint32_t dir; /* index into the directory array */
+	uint32_t name; /* string offset */
+};
+
+struct lookup_cache {
+	char *hier;
+	char *dbdir;
+	void *map;
+	size_t map_size;
+	const struct lookup_header *header;
+	const struct lookup_dir *dirs;
+	const struct lookup_file *files;
+	const uint32_t *keys;
+	const char *strings;
+	bool *stale; /* directories that have changed since */
+	uint32_t nstale;
+};
+
+/* Case-insensitive comparison in the C locale.  mandb and man may well run
+ * in different locales, and the order of the file array must not depend
+ * on that.
+ */
+static int lookup_ncasecmp (const char *left, const char *right, size_t n)
+{
+	for (; n; --n, ++left, ++right) {
+		unsigned char l = *left, r = *right;
+
+		if (l >= 'A' && l <= 'Z')
+			l += 'a' - 'A';
+		if (r >= 'A' && r <= 'Z')
+			r += 'a' - 'A';
+		if (l != r)
+			return l - r;
+		if (!l)
+			break;
+	}
+	return 0;
+}
+
+static bool get_db_mtime (const char *dbdir, struct timespec *mtime)
+{
+	char *dbname = mkdbname (dbdir);
+	struct stat st;
+	int ret;
+
+#ifdef NDBM
+	char *dirfile = xasprintf ("%s.dir", dbname);
+	ret = stat (dirfile, &st);
+	free (dirfile);
+#else
+	ret = stat (dbname, &st);
+#endif
+	free (dbname);
+	if (ret < 0)
+		return false;
+	*mtime = get_stat_mtime (&st);
+	return true;
+}
+
+static bool mtime_matches (const char *path, int64_t sec, int64_t nsec)
+{
+	struct stat st;
+	struct timespec mtime;
+
+	if (stat (path, &st) < 0)
+		return false;
+	mtime = get_stat_mtime (&st);
+	return mtime.tv_sec == sec && mtime.tv_nsec == nsec;
+}
+
+/* Is the directory at PATH the same one, unchanged, that DIR describes? */
+static bool dir_matches (const char *path, const struct lookup_dir *dir)
+{
+	struct stat st;
+	struct timespec mtime;
+
+	if (dir->mtime_sec == -1)
+		return is_directory (path) != 1;
+	if (stat (path, &st) < 0 || !S_ISDIR (st.st_mode))
+		return false;
+	mtime = get_stat_mtime (&st);
+	return mtime.tv_sec == dir->mtime_sec &&
+	       mtime.tv_nsec == dir->mtime_nsec &&
+	       (uint64_t) st.st_dev == dir->dev &&
+	       (uint64_t) st.st_ino == dir->ino;
+}
+
+char *lookup_cache_name (const char *dbdir)
+{
+	return xasprintf ("%s/index.lookup", dbdir);
+}
+
+/* Writing. */
+
+struct string_table {
+	char *data;
+	size_t len, max;
+};
+
+static uint32_t add_string (struct string_table *strings, const char *s)
+{
+	size_t size = strlen (s) + 1;
+	uint32_t offset = strings->len;
+
+	while (strings->len + size > strings->max)
+		strings->data = x2nrealloc (strings->data, &strings->max, 1);
+	memcpy (strings->data + strings->len, s, size);
+	strings->len += size;
+	return offset;
+}
+
+/* qsort doesn't pass any context to comparison functions. */
+static const struct string_table *sort_strings;
+
+static int dir_compare (const void *a, const void *b)
+{
+	const struct lookup_dir *left = a, *right = b;
+
+	return lookup_ncasecmp (sort_strings->data + left->name,
+	                        sort_strings->data + right->name, SIZE_MAX);
+}
+
+static int file_compare (const void *a, const void *b)
+{
+	const struct lookup_file *left = a, *right = b;
+	int cmp = lookup_ncasecmp (sort_strings->data + left->name,
+	                           sort_strings->data + right->name, SIZE_MAX);
+
+	if (cmp)
+		return cmp;
+	return (left->dir > right->dir) - (left->dir < right->dir);
+}
+
+static int key_compare (const void *a, const void *b)
+{
+	return strcmp (sort_strings->data + *(const uint32_t *) a,
+	               sort_strings->data + *(const uint32_t *) b);
+}
+
+/* Add the names of all man and cat directories in MANPATH to DIRS.
+ * Returns SIZE_MAX on error.
+ */
+static size_t scan_hierarchy (const char *manpath,
+                              struct string_table *strings,
+                              struct lookup_dir **dirs)
+{
+	DIR *dir;
+	struct dirent *entry;
+	size_t ndirs = 0, dirs_max = 0;
+
+	dir = opendir (manpath);
+	if (!dir)
+		return SIZE_MAX;
+	while ((entry = readdir (dir)) != NULL) {
+		if (!STRNEQ (entry->d_name, "man", 3) &&
+		    !STRNEQ (entry->d_name, "cat", 3))
+			continue;
+		if (ndirs >= dirs_max)
+			*dirs = x2nrealloc (*dirs, &dirs_max, sizeof **dirs);
+		memset (&(*dirs)[ndirs], 0, sizeof **dirs);
+		(*dirs)[ndirs].name = add_string (strings, entry->d_name);
+		++ndirs;
+	}
+	closedir (dir);
+
+	sort_strings = strings;
+	qsort (*dirs, ndirs, sizeof **dirs, dir_compare);
+	return ndirs;
+}
+
+/* Add the database keys, without their extensions, to KEYS.  Returns
+ * SIZE_MAX if the database cannot be read.
+ */
+static size_t scan_database (const char *dbdir, struct string_table *strings,
+                             uint32_t **keys)
+{
+	char *dbname = mkdbname (dbdir);
+	MYDBM_FILE dbf = MYDBM_NEW (dbname);
+	gl_set_t seen;
+	size_t nkeys = 0, keys_max = 0;
+	datum key;
+
+	free (dbname);
+	if (!MYDBM_RDOPEN (dbf) || dbver_rd (dbf)) {
+		MYDBM_FREE (dbf);
+		return SIZE_MAX;
+	}
+
+	seen = new_string_set (GL_HASH_SET);
+	key = MYDBM_FIRSTKEY (dbf);
+	while (MYDBM_DPTR (key) != NULL) {
+		datum nextkey;
+		char *name;
+
+		if (*MYDBM_DPTR (key) != '$') {
+			name = xstrndup (MYDBM_DPTR (key),
+			                 strcspn (MYDBM_DPTR (key), "\t"));
+			if (gl_set_add (seen, name)) {
+				if (nkeys >= keys_max)
+					*keys = x2nrealloc (*keys, &keys_max,
+					                    sizeof **keys);
+				(*keys)[nkeys++] = add_string (strings, name);
+			} else
+				free (name);
+		}
+		nextkey = MYDBM_NEXTKEY (dbf, key);
+		MYDBM_FREE_DPTR (key);
+		key = nextkey;
+	}
+	gl_set_free (seen);
+	MYDBM_FREE (dbf);
+
+	sort_strings = strings;
+	qsort (*keys, nkeys, sizeof **keys, key_compare);
+	return nkeys;
+}
+
+static bool write_all (int fd, const void *buf, size_t len)
+{
+	const char *p = buf;
+
+	while (len) {
+		ssize_t n = write (fd, p, len);
+		if (n < 0) {
+			if (errno == EINTR)
+				continue;
+			return false;
+		}
+		p += n;
+		len -= n;
+	}
+	return true;
+}
+
+bool lookup_cache_write (const char *manpath, const char *dbdir)
+{
+	struct lookup_header header;
+	struct string_table strings = {NULL, 0, 0};
+	struct lookup_dir *dirs = NULL;
+	struct lookup_file *files = NULL;
+	uint32_t *keys = NULL;
+	size_t ndirs, nfiles = 0, files_max = 0, nkeys, i;
+	struct stat st;
+	struct timespec db_mtime;
+	char *name = NULL, *tmpname = NULL;
+	int fd = -1;
+	bool ok = false;
+
+	/* Take modification times before reading anything, so that changes
+	 * made while we're working invalidate the cache rather than being
+	 * lost from it.
+	 */
+	if (!get_db_mtime (dbdir, &db_mtime) || stat (manpath, &st) < 0)
+		goto out;
+
+	memset (&header, 0, sizeof header);
+	header.magic = LOOKUP_MAGIC;
+	header.version = LOOKUP_VERSION;
+	header.hier_sec = get_stat_mtime (&st).tv_sec;
+	header.hier_nsec = get_stat_mtime (&st).tv_nsec;
+	header.db_sec = db_mtime.tv_sec;
+	header.db_nsec = db_mtime.tv_nsec;
+	header.hier = add_string (&strings, manpath);
+
+	ndirs = scan_hierarchy (manpath, &strings, &dirs);
+	if (ndirs == SIZE_MAX)
+		goto out;
+	for (i = 0; i < ndirs; ++i) {
+		char *path = xasprintf ("%s/%s", manpath,
+		                        strings.data + dirs[i].name);
+		DIR *dir;
+		struct dirent *entry;
+
+		/* Anything that isn't a directory can't contain pages;
+		 * leave it with a modification time that will never match
+		 * so that we notice if it turns into one.
+		 */
+		dirs[i].mtime_sec = -1;
+		dirs[i].mtime_nsec = -1;
+		if (stat (path, &st) < 0 || !S_ISDIR (st.st_mode)) {
+			free (path);
+			continue;
+		}
+		dirs[i].mtime_sec = get_stat_mtime (&st).tv_sec;
+		dirs[i].mtime_nsec = get_stat_mtime (&st).tv_nsec;
+		dirs[i].dev = st.st_dev;
+		dirs[i].ino = st.st_ino;
+
+		dir = opendir (path);
+		free (path);
+		if (!dir)
+			goto out;
+		while ((entry = readdir (dir)) != NULL) {
+			if (STREQ (entry->d_name, ".") ||
+			    STREQ (entry->d_name, ".."))
+				continue;
+			if (nfiles >= files_max)
+				files = x2nrealloc (files, &files_max,
+				                    sizeof *files);
+			files[nfiles].dir = i;
+			files[nfiles].name =
+			        add_string (&strings, entry->d_name);
+			++nfiles;
+		}
+		closedir (dir);
+	}
+	sort_strings = &strings;
+	qsort (files, nfiles, sizeof *files, file_compare);
+
+	nkeys = scan_database (dbdir, &strings, &keys);
+	if (nkeys == SIZE_MAX)
+		goto out;
+
+	if (strings.len > UINT32_MAX || nfiles > UINT32_MAX)
+		goto out;
+	header.ndirs = ndirs;
+	header.nfiles = nfiles;
+	header.nkeys = nkeys;
+	header.strings_size = strings.len;
+
+	name = lookup_cache_name (dbdir);
+	tmpname = xasprintf ("%s/%d.lookup", dbdir, getpid ());
+	fd = open (tmpname, O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, DBMODE);
+	if (fd < 0)
+		goto out;
+	if (!write_all (fd, &header, sizeof header) ||
+	    !write_all (fd, dirs, ndirs * sizeof *dirs) ||
+	    !write_all (fd, files, nfiles * sizeof *files) ||
+	    !write_all (fd, keys, nkeys * sizeof *keys) ||
+	    !write_all (fd, strings.data, strings.len))
+		goto out;
+	if (close (fd) < 0) {
+		fd = -1;
+		goto out;
+	}
+	fd = -1;
+	if (rename (tmpname, name) < 0)
+		goto out;
+
+	debug ("wrote lookup cache %s: %zu directories, %zu files, "
+	       "%zu keys\n",
+	       name, ndirs, nfiles, nkeys);
+	ok = true;
+
+out:
+	if (fd >= 0)
+		close (fd);
+	if (!ok) {
+		debug ("failed to write lookup cache for %s\n", manpath);
+		if (tmpname)
+			unlink (tmpname);
+	}
+	free (tmpname);
+	free (name);
+	free (keys);
+	free (files);
+	free (dirs);
+	free (strings.data);
+	return ok;
+}
+
+/* Reading. */
+
+static const char *cache_string (const struct lookup_cache *cache,
+                                 uint32_t offset)
+{
+	if (offset >= cache->header->strings_size)
+		return "";
+	return cache->strings + offset;
+}
+
+/* Check whether CACHE's hierarchy and database are unchanged since it was
+ * written, and note which of its directories have changed.  Returns false
+ * if the cache can no longer be used at all.
+ */
+bool lookup_cache_revalidate (struct lookup_cache *cache)
+{
+	const struct lookup_header *header = cache->header;
+	struct timespec db_mtime;
+	uint32_t i;
+
+	if (!mtime_matches (cache->hier, header->hier_sec,
+	                    header->hier_nsec) ||
+	    !get_db_mtime (cache->dbdir, &db_mtime) ||
+	    db_mtime.tv_sec != header->db_sec ||
+	    db_mtime.tv_nsec != header->db_nsec) {
+		debug ("lookup cache for %s is out of date\n", cache->hier);
+		return false;
+	}
+	cache->nstale = 0;
+	for (i = 0; i < header->ndirs; ++i) {
+		const struct lookup_dir *dir = &cache->dirs[i];
+		char *path = xasprintf ("%s/%s", cache->hier,
+		                        cache_string (cache, dir->name));
+
+		cache->stale[i] = !dir_matches (path, dir);
+		if (cache->stale[i]) {
+			debug ("lookup cache for %s: %s has changed\n",
+			       cache->hier, path);
+			++cache->nstale;
+		}
+		free (path);
+	}
+	return true;
+}
+
+struct lookup_cache *lookup_cache_open (const char *manpath,
+                                        const char *dbdir)
+{
+	struct lookup_cache *cache;
+	const struct lookup_header *header;
+	char *name;
+	int fd;
+	struct stat st;
+	void *map;
+	uint64_t expected;
+
+	name = lookup_cache_name (dbdir);
+	fd = open (name, O_RDONLY | O_CLOEXEC);
+	if (fd < 0) {
+		debug ("no lookup cache %s\n", name);
+		free (name);
+		return NULL;
+	}
+	if (fstat (fd, &st) < 0 ||
+	    (size_t) st.st_size < sizeof (struct lookup_header)) {
+		close (fd);
+		free (name);
+		return NULL;
+	}
+	map = mmap (NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+	close (fd);
+	if (map == MAP_FAILED) {
+		free (name);
+		return NULL;
+	}
+
+	cache = XZALLOC (struct lookup_cache);
+	cache->hier = xstrdup (manpath);
+	cache->map = map;
+	cache->map_size = st.st_size;
+	cache->header = header = map;
+
+	if (header->magic != LOOKUP_MAGIC ||
+	    header->version != LOOKUP_VERSION) {
+		debug ("lookup cache %s has the wrong format\n", name);
+		goto invalid;
+	}
+	expected = sizeof *header +
+	           (uint64_t) header->ndirs * sizeof (struct lookup_dir) +
+	           (uint64_t) header->nfiles * sizeof (struct lookup_file) +
+	           (uint64_t) header->nkeys * sizeof (uint32_t) +
+	           header->strings_size;
+	if (expected != (uint64_t) st.st_size || !header->strings_size) {
+		debug ("lookup cache %s is truncated\n", name);
+		goto invalid;
+	}
+	cache->dirs = (const struct lookup_dir *) (header + 1);
+	cache->files = (const struct lookup_file *) (cache->dirs +
+	                                             header->ndirs);
+	cache->keys = (const uint32_t *) (cache->files + header->nfiles);
+	cache->strings = (const char *) (cache->keys + header->nkeys);
+	if (cache->strings[header->strings_size - 1] != '\0' ||
+	    !STREQ (cache_string (cache, header->hier), manpath))
+		goto invalid;
+
+	cache->dbdir = xstrdup (dbdir);
+	cache->stale = XCALLOC (header->ndirs, bool);
+	if (!lookup_cache_revalidate (cache))
+		goto invalid;
+
+	debug ("using lookup cache %s\n", name);
+	free (name);
+	return cache;
+
+invalid:
+	free (name);
+	lookup_cache_close (cache);
+	return NULL;
+}
+
+void lookup_cache_close (struct lookup_cache *cache)
+{
+	if (!cache)
+		return;
+	munmap (cache->map, cache->map_size);
+	free (cache->stale);
+	free (cache->dbdir);
+	free (cache->hier);
+	free (cache);
+}
+
+bool lookup_cache_is_current (const struct lookup_cache *cache)
+{
+	return cache->nstale == 0;
+}
+
+/* Add to MATCHED each file in directory DIR, among files FIRST to LAST,
+ * that matches PATTERN.
+ */
+static void match_files (const struct lookup_cache *cache, uint32_t dir,
+                         size_t first, size_t last, const char *pattern,
+                         int opts, gl_list_t matched)
+{
+	int flags = (opts & LFF_MATCHCASE) ? 0 : FNM_CASEFOLD;
+	const char *subdir = cache_string (cache, cache->dirs[dir].name);
+	size_t i;
+
+	if (cache->stale[dir]) {
+		char *path = xasprintf ("%s/%s", cache->hier, subdir);
+
+		match_in_directory (path, pattern, opts, matched);
+		free (path);
+		return;
+	}
+
+	for (i = first; i < last; ++i) {
+		const char *name;
+
+		if (cache->files[i].dir != dir)
+			continue;
+		name = cache_string (cache, cache->files[i].name);
+		if (fnmatch (pattern, name, flags) != 0)
+			continue;
+		debug ("matched: %s/%s/%s\n", cache->hier, subdir, name);
+		gl_list_add_last (matched, xasprintf ("%s/%s/%s", cache->hier,
+		                                      subdir, name));
+	}
+}
+
+static void match_in_dir (const struct lookup_cache *cache,
+                          const char *subdir, size_t first, size_t last,
+                          const char *pattern, int opts, gl_list_t matched)
+{
+	uint32_t i;
+
+	for (i = 0; i < cache->header->ndirs; ++i)
+		if (STREQ (cache_string (cache, cache->dirs[i].name), subdir))
+			match_files (cache, i, first, last, pattern, opts,
+			             matched);
+}
+
+gl_list_t lookup_cache_files (const struct lookup_cache *cache,
+                              const char *sec, const char *unesc_name,
+                              bool cat, int opts)
+{
+	gl_list_t matched;
+	const char *prefix = cat ? "cat" : "man";
+	char *name, *stem, *pattern, *subdir;
+	size_t stem_len, lo, hi, first, last;
+	int layout;
+
+	if (opts & (LFF_REGEX | LFF_WILDCARD))
+		return NULL;
+
+	/* Every pattern that look_for_file uses for a plain name requires
+	 * the file name to start with "NAME.", so narrow down the files to
+	 * consider by binary search.
+	 */
+	stem = xasprintf ("%s.", unesc_name);
+	stem_len = strlen (stem);
+	lo = 0;
+	hi = cache->header->nfiles;
+	while (lo < hi) {
+		size_t mid = lo + (hi - lo) / 2;
+		const char *file =
+		        cache_string (cache, cache->files[mid].name);
+
+		if (lookup_ncasecmp (file, stem, stem_len) < 0)
+			lo = mid + 1;
+		else
+			hi = mid;
+	}
+	first = last = lo;
+	while (last < cache->header->nfiles &&
+	       !lookup_ncasecmp (cache_string (cache, cache->files[last].name),
+	                         stem, stem_len))
+		++last;
+	free (stem);
+
+	debug ("lookup cache %s: %zu candidate file(s) for %s\n", cache->hier,
+	       last - first, unesc_name);
+
+	matched = new_string_list (GL_ARRAY_LIST, false);
+	name = escape_shell (unesc_name);
+	layout = get_mandir_layout ();
+
+	/* Follow look_for_file's search order exactly. */
+	if (layout & LAYOUT_GNU) {
+		char *dir_pattern = xasprintf ("%s\t*", prefix);
+		uint32_t i;
+
+		*strrchr (dir_pattern, '\t') = *sec;
+		pattern = make_pattern (name, sec, opts);
+		for (i = 0; i < cache->header->ndirs; ++i)
+			if (fnmatch (dir_pattern,
+			             cache_string (cache, cache->dirs[i].name),
+			             0) == 0)
+				match_files (cache, i, first, last, pattern,
+				             opts, matched);
+		free (pattern);
+		free (dir_pattern);
+	}
+
+	if ((layout & LAYOUT_HPUX) && gl_list_size (matched) == 0) {
+		subdir = xasprintf ("%s%s.Z", prefix, sec);
+		pattern = make_pattern (name, sec, opts);
+		match_in_dir (cache, subdir, first, last, pattern, opts,
+		              matched);
+		free (pattern);
+		free (subdir);
+	}
+
+	if ((layout & LAYOUT_IRIX) && gl_list_size (matched) == 0) {
+		subdir = xasprintf ("%s%s", prefix, sec);
+		pattern = xasprintf ("%s.*", name);
+		match_in_dir (cache, subdir, first, last, pattern, opts,
+		              matched);
+		free (pattern);
+		free (subdir);
+	}
+
+	if ((layout & LAYOUT_SOLARIS) && gl_list_size (matched) == 0) {
+		subdir = xasprintf ("%s%s", prefix, sec);
+		pattern = make_pattern (name, sec, opts);
+		match_in_dir (cache, subdir, first, last, pattern, opts,
+		              matched);
+		free (pattern);
+		free (subdir);
+	}
+
+	if ((layout & LAYOUT_BSD) && gl_list_size (matched) == 0) {
+		subdir = xasprintf ("%s%s", prefix, sec);
+		if (cat)
+			pattern = xasprintf ("%s.0*", name);
+		else
+			pattern = make_pattern (name, sec, opts);
+		match_in_dir (cache, subdir, first, last, pattern, opts,
+		              matched);
+		free (pattern);
+		free (subdir);
+	}
+
+	free (name);
+	return matched;
+}
+
+bool lookup_cache_has_key (const struct lookup_cache *cache,
+                           const char *name)
+{
+	char *key = name_to_key (name);
+	size_t lo = 0, hi = cache->header->nkeys;
+	bool found = false;
+
+	while (lo < hi) {
+		size_t mid = lo + (hi - lo) / 2;
+		int cmp = strcmp (key, cache_string (cache, cache->keys[mid]));
+
+		if (cmp == 0) {
+			found = true;
+			break;
+		} else if (cmp < 0)
+			hi = mid;
+		else
+			lo = mid + 1;
+	}
+
+	free (key);
+	return found;
+}
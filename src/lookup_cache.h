@@ -0,0 +1,73 @@
+/*
+ * lookup_cache.h: interface to the page lookup cache
+ *
+ * Copyright (C) 2024 Colin Watson.
+ *
+ * This file is part of man-db.
+ *
+ * man-db is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * man-db is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with man-db; if not, write to the Free Software Foundation,
+ * Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ */
+
+#ifndef MAN_LOOKUP_CACHE_H
+#define MAN_LOOKUP_CACHE_H
+
+#include <stdbool.h>
+
+#include "gl_list.h"
+
+/* A snapshot of the man and cat directories of one hierarchy, together
+ * with the set of names in its database.  mandb writes one of these next
+ * to each database; man uses it to answer lookups without reading
+ * directories or opening the database.
+ */
+struct lookup_cache;
+
+/* Return the file name of the lookup cache for the database in DBDIR. */
+extern char *lookup_cache_name (const char *dbdir);
+
+/* Take a new snapshot of MANPATH, whose database is in DBDIR.  Returns
+ * true on success.
+ */
+extern bool lookup_cache_write (const char *manpath, const char *dbdir);
+
+/* Open the lookup cache for MANPATH, whose database is in DBDIR.  Returns
+ * NULL if there is no cache, or if the set of directories in the
+ * hierarchy or its database have changed since it was written.
+ * Individual directories that have changed are read directly when needed.
+ */
+extern struct lookup_cache *lookup_cache_open (const char *manpath,
+                                               const char *dbdir);
+extern void lookup_cache_close (struct lookup_cache *cache);
+
+/* Check CACHE against the current state of its hierarchy and database,
+ * as lookup_cache_open does.  Returns false if CACHE must be discarded.
+ */
+extern bool lookup_cache_revalidate (struct lookup_cache *cache);
+
+/* Return true if no directories have changed since CACHE was written. */
+extern bool lookup_cache_is_current (const struct lookup_cache *cache);
+
+/* Equivalent to look_for_file (manpath, SEC, NAME, CAT, OPTS).  Returns
+ * NULL if the cache cannot answer this kind of query.
+ */
+extern gl_list_t lookup_cache_files (const struct lookup_cache *cache,
+                                     const char *sec, const char *name,
+                                     bool cat, int opts);
+
+/* Return true if the database might contain entries for NAME. */
+extern bool lookup_cache_has_key (const struct lookup_cache *cache,
+                                  const char *name);
+
+#endif /* MAN_LOOKUP_CACHE_H */
@@ -25,6 +25,7 @@
 #endif /* HAVE_CONFIG_H */
 
 #include <assert.h>
+#include <errno.h>
 #include <fcntl.h>
 #include <stdbool.h>
 #include <stdlib.h>
@@ -58,6 +59,7 @@
 #include "fatal.h"
 #include "glcontainers.h"
 #include "sandbox.h"
+#include "security.h"
 #include "util.h"
 
 #include "decompress.h"
@@ -71,6 +73,7 @@ static char *to_code;
 static gl_list_t filenames;
 static const char *suffix;
 static bool in_place;
+static long jobs = 1;
 
 struct try_file_at_args {
 	int dir_fd;
@@ -113,6 +116,8 @@ static struct argp_option options[] = {
              N_ ("suffix to append to output file name")),
         OPT ("in-place", OPT_IN_PLACE, 0,
              N_ ("overwrite input files in place")),
+        OPT ("jobs", 'j', N_ ("JOBS"),
+             N_ ("number of files to recode at once")),
         OPT ("debug", 'd', 0, N_ ("emit debugging messages")),
         OPT ("quiet", 'q', 0, N_ ("produce fewer warnings")),
         OPT_HELP_COMPAT,
@@ -130,6 +135,17 @@ static error_t parse_opt (int key, char *arg, struct argp_state *state)
 		case OPT_IN_PLACE:
 			in_place = true;
 			return 0;
+		case 'j': {
+			char *end;
+
+			errno = 0;
+			jobs = strtol (arg, &end, 10);
+			if (errno || end == arg || *end || jobs < 1)
+				argp_error (state,
+				            _ ("invalid number of jobs: %s"),
+				            arg);
+			return 0;
+		}
 		case 'd':
 			debug_level = true;
 			return 0;
@@ -165,17 +181,92 @@ static error_t parse_opt (int key, char *arg, struct argp_state *state)
 
 static struct argp argp = {options, parse_opt, args_doc};
 
+static bool write_all (int fd, const void *buf, size_t len)
+{
+	const char *p = buf;
+
+	while (len) {
+		ssize_t n = write (fd, p, len);
+		if (n < 0) {
+			if (errno == EINTR)
+				continue;
+			return false;
+		}
+		p += n;
+		len -= n;
+	}
+	return true;
+}
+
+/* Convert a page using a pipeline, possibly including decompressor and
+ * manconv subprocesses.  If OUTFD is -1, write to OUTFILENAME; otherwise,
+ * write to OUTFD.
+ */
+static void recode_pipeline (decompress *decomp, const char *page_encoding,
+                             const char *outfilename, int outfd)
+{
+	pipeline *convert, *decomp_p;
+	int status;
+
+	convert = pipeline_new ();
+	if (outfd == -1)
+		pipeline_want_outfile (convert, outfilename);
+	else
+		pipeline_want_out (convert, outfd);
+	add_manconv (convert, page_encoding, to_code);
+
+	if (!pipeline_get_ncommands (convert))
+		pipeline_command (convert, pipecmd_new_passthrough ());
+
+	decomp_p = decompress_get_pipeline (decomp);
+	pipeline_connect (decomp_p, convert, nullptr);
+	pipeline_pump (decomp_p, convert, nullptr);
+	pipeline_wait (decomp_p);
+	status = pipeline_wait (convert);
+	if (status != 0)
+		error (CHILD_FAIL, 0, _ ("command exited with status %d: %s"),
+		       status, pipeline_tostring (convert));
+
+	pipeline_free (convert);
+}
+
+/* Convert a page that has already been decompressed in-process, and write
+ * the result out directly without starting any subprocesses.  If OUTFD is
+ * -1, write to OUTFILENAME; otherwise, write to OUTFD.
+ */
+static void recode_inprocess (decompress *decomp, const char *page_encoding,
+                              const char *outfilename, int outfd)
+{
+	if (manconv_inprocess (decomp, page_encoding, to_code) != 0)
+		/* manconv already wrote an error message to stderr.  Just
+		 * exit non-zero.
+		 */
+		exit (FATAL);
+
+	if (outfd == -1) {
+		outfd = open (outfilename, O_WRONLY | O_CREAT | O_TRUNC, 0666);
+		if (outfd == -1)
+			fatal (errno, _ ("can't open %s"), outfilename);
+	}
+	if (!write_all (outfd, decompress_inprocess_buf (decomp),
+	                decompress_inprocess_len (decomp)) ||
+	    close (outfd) == -1)
+		fatal (errno, _ ("can't write to %s"), outfilename);
+}
+
 static void recode (const char *filename)
 {
 	decompress *decomp;
-	pipeline *convert, *decomp_p;
 	struct compression *comp;
-	int dir_fd = -1;
+	int dir_fd = -1, outfd = -1;
 	char *dirname, *basename, *stem, *outfilename;
 	char *page_encoding;
-	int status;
 
-	decomp = decompress_open (filename, 0);
+	/* In-process decompression implies in-process conversion, which
+	 * add_manconv avoids when running setuid; do the same here.
+	 */
+	decomp = decompress_open (
+	        filename, running_setuid () ? 0 : DECOMPRESS_ALLOW_INPROCESS);
 	if (!decomp)
 		error (FAIL, 0, _ ("can't open %s"), filename);
 
@@ -187,14 +278,11 @@ static void recode (const char *filename)
 	else
 		stem = xstrdup (basename);
 
-	convert = pipeline_new ();
-	if (suffix) {
+	if (suffix)
 		outfilename = xasprintf ("%s/%s%s", dirname, stem, suffix);
-		pipeline_want_outfile (convert, outfilename);
-	} else {
+	else {
 		int dir_fd_open_flags;
 		char *template_path;
-		int outfd;
 
 		dir_fd_open_flags = O_SEARCH | O_DIRECTORY;
 #ifdef O_PATH
@@ -212,7 +300,6 @@ static void recode (const char *filename)
 			fatal (errno, _ ("can't open temporary file %s"),
 			       template_path);
 		free (template_path);
-		pipeline_want_out (convert, outfd);
 	}
 
 	decompress_start (decomp);
@@ -223,19 +310,11 @@ static void recode (const char *filename)
 		free (lang);
 	}
 	debug ("guessed input encoding %s for %s\n", page_encoding, filename);
-	add_manconv (convert, page_encoding, to_code);
 
-	if (!pipeline_get_ncommands (convert))
-		pipeline_command (convert, pipecmd_new_passthrough ());
-
-	decomp_p = decompress_get_pipeline (decomp);
-	pipeline_connect (decomp_p, convert, nullptr);
-	pipeline_pump (decomp_p, convert, nullptr);
-	pipeline_wait (decomp_p);
-	status = pipeline_wait (convert);
-	if (status != 0)
-		error (CHILD_FAIL, 0, _ ("command exited with status %d: %s"),
-		       status, pipeline_tostring (convert));
+	if (decompress_is_pipeline (decomp))
+		recode_pipeline (decomp, page_encoding, outfilename, outfd);
+	else
+		recode_inprocess (decomp, page_encoding, outfilename, outfd);
 
 	if (in_place) {
 		assert (dir_fd != -1);
@@ -260,13 +339,65 @@ static void recode (const char *filename)
 	free (dirname);
 	if (dir_fd)
 		close (dir_fd);
-	pipeline_free (convert);
 	decompress_free (decomp);
 }
 
+/* Each worker process recodes every JOBS'th file, starting from its own
+ * index.  Dividing the work up front like this needs no communication
+ * between workers, and since files are given in whatever order the caller
+ * chose, there is no reason to expect any worker to be systematically
+ * slower than the others.
+ */
+static void recode_worker (void *data)
+{
+	size_t i;
+
+	for (i = *(size_t *) data; i < gl_list_size (filenames); i += jobs)
+		recode (gl_list_get_at (filenames, i));
+}
+
+/* Recode all files using up to JOBS worker processes.  Returns the first
+ * non-zero exit status of any worker, or zero if they all succeeded.
+ */
+static int recode_parallel (void)
+{
+	size_t nworkers, i;
+	pipeline **workers;
+	size_t *indices;
+	int ret = 0;
+
+	nworkers = gl_list_size (filenames);
+	if (nworkers > (size_t) jobs)
+		nworkers = jobs;
+	workers = XNMALLOC (nworkers, pipeline *);
+	indices = XNMALLOC (nworkers, size_t);
+
+	for (i = 0; i < nworkers; ++i) {
+		pipecmd *cmd;
+
+		indices[i] = i;
+		cmd = pipecmd_new_function ("man-recode", &recode_worker,
+		                            NULL, &indices[i]);
+		workers[i] = pipeline_new_commands (cmd, nullptr);
+		pipeline_start (workers[i]);
+	}
+
+	for (i = 0; i < nworkers; ++i) {
+		int status = pipeline_wait (workers[i]);
+		if (status != 0 && ret == 0)
+			ret = status;
+		pipeline_free (workers[i]);
+	}
+
+	free (indices);
+	free (workers);
+	return ret;
+}
+
 int main (int argc, char *argv[])
 {
 	const char *filename;
+	int status = OK;
 
 	set_program_name (argv[0]);
 
@@ -279,13 +410,17 @@ int main (int argc, char *argv[])
 	if (argp_parse (&argp, argc, argv, 0, 0, 0))
 		exit (FAIL);
 
-	GL_LIST_FOREACH (filenames, filename)
-		recode (filename);
+	if (jobs > 1 && gl_list_size (filenames) > 1)
+		status = recode_parallel ();
+	else {
+		GL_LIST_FOREACH (filenames, filename)
+			recode (filename);
+	}
 
 	free (to_code);
 
 	gl_list_free (filenames);
 	sandbox_free (sandbox);
 
-	return 0;
+	return status;
 }
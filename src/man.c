@@ -95,6 +95,7 @@
 #include "fatal.h"
 #include "filenames.h"
 #include "glcontainers.h"
+#include "intern.h"
 #include "linelength.h"
 #include "orderfiles.h"
 #include "pathsearch.h"
@@ -109,10 +110,13 @@
 #include "mydbm.h"
 
 #include "globbing.h"
+#include "lookup_cache.h"
 #include "manconv.h"
 #include "manconv_client.h"
 #include "manp.h"
+#include "pump.h"
 #include "ult_src.h"
+#include "ult_store.h"
 #include "zsoelim.h"
 
 #ifdef MAN_OWNER
@@ -182,6 +186,7 @@ enum opts {
 	OPT_NO_HYPHENATION,
 	OPT_NO_JUSTIFICATION,
 	OPT_NO_SUBPAGES,
+	OPT_BATCH,
 	OPT_MAX
 };
 
@@ -206,6 +211,7 @@ static const char *std_sections[] = STD_SECTIONS;
 static char *manp;
 static const char *external;
 static gl_map_t db_map = NULL;
+static gl_map_t lookup_map = NULL;
 
 static bool troff;
 static const char *roff_device = NULL;
@@ -229,6 +235,7 @@ static const char *recode = NULL;
 static bool no_hyphenation;
 static bool no_justification;
 static bool subpages = true;
+static bool batch;
 
 static bool ascii;    /* insert tr in the output pipe */
 static bool save_cat; /* security breach? Can we save the cat? */
@@ -291,6 +298,9 @@ static struct argp_option options[] = {
         OPT ("where-cat", 'W', 0,
              N_ ("print physical location of cat file(s)")),
         OPT_ALIAS ("location-cat", 0),
+        OPT ("batch", OPT_BATCH, 0,
+             N_ ("read PAGE arguments from standard input, one query per "
+                 "line")),
         OPT ("local-file", 'l', 0,
              N_ ("interpret PAGE argument(s) as local filename(s)")),
         OPT ("catman", 'c', 0,
@@ -492,6 +502,9 @@ static error_t parse_opt (int key, char *arg, struct argp_state *state)
 		case OPT_NO_SUBPAGES:
 			subpages = false;
 			return 0;
+		case OPT_BATCH:
+			batch = true;
+			return 0;
 
 		case 'P':
 			pager = arg;
@@ -581,6 +594,9 @@ static error_t parse_opt (int key, char *arg, struct argp_state *state)
 				            _ ("%s: incompatible options"),
 				            badopts);
 			}
+			if (batch && !print_where && !print_where_cat)
+				argp_error (state,
+				            _ ("--batch requires -w or -W"));
 			return 0;
 	}
 	return ARGP_ERR_UNKNOWN;
@@ -907,6 +923,9 @@ static int run_mandb (bool create, const char *manpath, const char *filename)
 	pipeline *mandb_pl = pipeline_new ();
 	pipecmd *mandb_cmd = pipecmd_new ("mandb");
 
+	/* mandb may need to lock databases that we have open. */
+	dbcache_close_all ();
+
 	if (debug_level)
 		pipecmd_arg (mandb_cmd, "-d");
 	else
@@ -1932,13 +1951,11 @@ static int format_display_and_save (decompress *d, pipeline *format_cmd,
 	maybe_discard_stderr (format_cmd);
 
 	pipeline_connect (decomp, format_cmd, nullptr);
-	if (sav_p) {
+	if (sav_p)
 		pipeline_connect (format_cmd, disp_cmd, sav_p, nullptr);
-		pipeline_pump (decomp, format_cmd, disp_cmd, sav_p, nullptr);
-	} else {
+	else
 		pipeline_connect (format_cmd, disp_cmd, nullptr);
-		pipeline_pump (decomp, format_cmd, disp_cmd, nullptr);
-	}
+	zerocopy_pump (decomp, format_cmd, disp_cmd, sav_p);
 
 	if (global_manpath)
 		regain_effective_privs ();
@@ -1999,7 +2016,7 @@ static void format_display (decompress *d, pipeline *format_cmd,
 			       htmlfile);
 		pipeline_want_out (format_cmd, htmlfd);
 		pipeline_connect (decomp, format_cmd, nullptr);
-		pipeline_pump (decomp, format_cmd, nullptr);
+		zerocopy_pump (decomp, NULL, format_cmd, NULL);
 		pipeline_wait (decomp);
 		format_status = pipeline_wait (format_cmd);
 	} else
@@ -2007,13 +2024,13 @@ static void format_display (decompress *d, pipeline *format_cmd,
 		if (format_cmd) {
 			pipeline_connect (decomp, format_cmd, nullptr);
 			pipeline_connect (format_cmd, disp_cmd, nullptr);
-			pipeline_pump (decomp, format_cmd, disp_cmd, nullptr);
+			zerocopy_pump (decomp, format_cmd, disp_cmd, NULL);
 			pipeline_wait (decomp);
 			format_status = pipeline_wait (format_cmd);
 			disp_status = pipeline_wait (disp_cmd);
 		} else {
 			pipeline_connect (decomp, disp_cmd, nullptr);
-			pipeline_pump (decomp, disp_cmd, nullptr);
+			zerocopy_pump (decomp, NULL, disp_cmd, NULL);
 			pipeline_wait (decomp);
 			disp_status = pipeline_wait (disp_cmd);
 		}
@@ -2105,7 +2122,7 @@ static void display_catman (const char *cat_file, decompress *d,
 	 */
 	drop_effective_privs ();
 	pipeline_connect (decomp, format_cmd, nullptr);
-	pipeline_pump (decomp, format_cmd, nullptr);
+	zerocopy_pump (decomp, NULL, format_cmd, NULL);
 	pipeline_wait (decomp);
 	status = pipeline_wait (format_cmd);
 	regain_effective_privs ();
@@ -2371,7 +2388,7 @@ static int display (const char *dir, const char *man_file,
 			}
 			drop_effective_privs ();
 			pipeline_connect (decomp_p, format_cmd, nullptr);
-			pipeline_pump (decomp_p, format_cmd, nullptr);
+			zerocopy_pump (decomp_p, NULL, format_cmd, NULL);
 			pipeline_wait (decomp_p);
 			status = pipeline_wait (format_cmd);
 			regain_effective_privs ();
@@ -2717,6 +2734,36 @@ static int get_ult_flags (char from_db, char id)
 		return ult_flags;
 }
 
+/* Like ult_src, but for pages found in the database, use the resolution
+ * that mandb stored there if nothing it depends on has changed since.
+ * This saves opening and decompressing pages to look for .so requests.
+ */
+static const struct ult_value *find_ult_src (const char *file,
+                                             const char *path, char from_db,
+                                             char id)
+{
+	int flags = get_ult_flags (from_db, id);
+
+	if (from_db) {
+		char *catpath, *database;
+		MYDBM_FILE dbf;
+		const struct ult_value *ult = NULL;
+
+		catpath = get_catpath (path,
+		                       global_manpath ? SYSTEM_CAT : USER_CAT);
+		database = mkdbname (catpath ? catpath : path);
+		dbf = dbcache_open (database);
+		if (dbf)
+			ult = ult_store_lookup (dbf, file, flags);
+		free (database);
+		free (catpath);
+		if (ult)
+			return ult;
+	}
+
+	return ult_src (file, path, NULL, flags);
+}
+
 /* Is this candidate substantially a duplicate of a previous one?
  * Returns true if so, otherwise false.
  */
@@ -2731,8 +2778,8 @@ static bool duplicate_candidates (struct candidate *left,
 		return true; /* same ultimate source file */
 
 	if (!STREQ (left->source->name, right->source->name) ||
-	    !STREQ (left->source->sec, right->source->sec) ||
-	    !STREQ (left->source->ext, right->source->ext))
+	    left->source->sec != right->source->sec ||
+	    left->source->ext != right->source->ext)
 		return false; /* different name/section/extension */
 
 	if (STREQ (left->path, right->path))
@@ -2831,7 +2878,7 @@ static int compare_candidates (const struct candidate *left,
 	 * becomes a pure section; this allows extensions to be selectively
 	 * moved out of order with respect to their parent sections.
 	 */
-	if (strcmp (lsource->ext, rsource->ext)) {
+	if (lsource->ext != rsource->ext) {
 		size_t index_left, index_right;
 
 		/* If the user asked for an explicit section, sort exact
@@ -3025,8 +3072,7 @@ static int add_candidate (struct candidate **head, char from_db, char cat,
 		                          cat ? "cat" : "man");
 		if (!filename)
 			return 0;
-		ult_value = ult_src (filename, path, NULL,
-		                     get_ult_flags (from_db, source->id));
+		ult_value = find_ult_src (filename, path, from_db, source->id);
 		if (ult_value)
 			ult = ult_value->path;
 		free (filename);
@@ -3154,6 +3200,74 @@ static void sort_candidates (struct candidate **candidates)
 	free (allcands);
 }
 
+static void lookup_map_value_free (const void *value)
+{
+	/* The value may be NULL to indicate that there is no usable lookup
+	 * cache at this location.
+	 */
+	lookup_cache_close ((struct lookup_cache *) value);
+}
+
+/* Return the lookup cache for this manpath, or NULL if there isn't an
+ * up-to-date one.
+ */
+static const struct lookup_cache *get_lookup_cache (const char *manpath)
+{
+	struct lookup_cache *cache;
+
+	if (!lookup_map)
+		lookup_map = new_string_map (GL_HASH_MAP, lookup_map_value_free);
+
+	if (!gl_map_search (lookup_map, manpath, (const void **) &cache)) {
+		char *catpath = get_catpath (
+		        manpath, global_manpath ? SYSTEM_CAT : USER_CAT);
+
+		cache = lookup_cache_open (manpath, catpath ? catpath : manpath);
+		gl_map_put (lookup_map, xstrdup (manpath), cache);
+		free (catpath);
+	}
+
+	return cache;
+}
+
+/* Check each lookup cache opened so far against the current state of its
+ * hierarchy, and drop those that can no longer be used so that they are
+ * opened afresh.  This matters when one process answers many queries.
+ */
+static void revalidate_lookup_caches (void)
+{
+	gl_list_t invalid;
+	const char *manpath;
+	struct lookup_cache *cache;
+
+	if (!lookup_map)
+		return;
+
+	invalid = new_string_list (GL_ARRAY_LIST, false);
+	GL_MAP_FOREACH (lookup_map, manpath, cache)
+		if (!cache || !lookup_cache_revalidate (cache))
+			gl_list_add_last (invalid, xstrdup (manpath));
+	GL_LIST_FOREACH (invalid, manpath)
+		gl_map_remove (lookup_map, manpath);
+	gl_list_free (invalid);
+}
+
+/* Like look_for_file, but answered from the lookup cache if possible. */
+static gl_list_t find_files (const char *path, const char *sec,
+                             const char *name, bool cat, int lff_opts)
+{
+	const struct lookup_cache *cache = get_lookup_cache (path);
+
+	if (cache) {
+		gl_list_t names =
+		        lookup_cache_files (cache, sec, name, cat, lff_opts);
+		if (names)
+			return names;
+	}
+
+	return look_for_file (path, sec, name, cat, lff_opts);
+}
+
 /*
  * See if the preformatted man page or the source exists in the given
  * section.
@@ -3164,6 +3278,7 @@ static int try_section (const char *path, const char *sec, const char *name,
 	int found = 0;
 	gl_list_t names = NULL;
 	const char *found_name;
+	struct file_order *order;
 	char cat = 0;
 	int lff_opts = (match_case ? LFF_MATCHCASE : 0) |
 	               (regex_opt ? LFF_REGEX : 0) |
@@ -3176,7 +3291,7 @@ static int try_section (const char *path, const char *sec, const char *name,
 	 * Look for man page source files.
 	 */
 
-	names = look_for_file (path, sec, name, false, lff_opts);
+	names = find_files (path, sec, name, false, lff_opts);
 	if (!gl_list_size (names))
 	/*
 	 * No files match.
@@ -3191,21 +3306,21 @@ static int try_section (const char *path, const char *sec, const char *name,
 		if (!troff && !want_encoding && !recode) {
 			if (names)
 				gl_list_free (names);
-			names = look_for_file (path, sec, name, true,
-			                       lff_opts);
+			names = find_files (path, sec, name, true, lff_opts);
 			cat = 1;
 		}
 	}
 	if (!names)
 		return 0;
 
-	order_files (path, &names);
+	order = order_files (path, &names);
 
 	GL_LIST_FOREACH (names, found_name) {
 		struct mandata *info = filename_info (found_name, quiet < 2);
 		const struct ult_value *ult;
 		int f;
 
+		order_files_next (order);
 		if (!info)
 			continue;
 
@@ -3234,6 +3349,7 @@ static int try_section (const char *path, const char *sec, const char *name,
 		/* Don't free info here. */
 	}
 
+	order_files_free (order);
 	gl_list_free (names);
 	return found;
 }
@@ -3292,6 +3408,10 @@ static void dbdelete_wrapper (const char *page, struct mandata *info,
 		catpath = get_catpath (manpath,
 		                       global_manpath ? SYSTEM_CAT : USER_CAT);
 		database = mkdbname (catpath ? catpath : manpath);
+		/* Don't hold a reader's lock on the database while we try
+		 * to write to it.
+		 */
+		dbcache_close_all ();
 		dbf = MYDBM_NEW (database);
 		if (MYDBM_RWOPEN (dbf)) {
 			if (dbdelete (dbf, page, info) == 1)
@@ -3344,8 +3464,11 @@ static int display_database (struct candidate *candp)
 			const struct ult_value *man_ult;
 			char *cat_file;
 
-			man_ult = ult_src (file, candp->path, NULL,
-			                   get_ult_flags (1, in->id));
+			man_ult = find_ult_src (file, candp->path, 1, in->id);
+			/* That may have opened the database again; don't
+			 * hold it open while the page is displayed.
+			 */
+			dbcache_close_all ();
 			if (!man_ult) {
 				free (title);
 				return found; /* zero */
@@ -3500,6 +3623,18 @@ static void db_map_value_free (const void *value)
 		gl_list_free ((gl_list_t) value);
 }
 
+/* Does the database entry LOC belong to the interned section ISEC and, if
+ * given, the interned extension IEXT?
+ */
+static bool db_entry_matches (const struct mandata *loc, const char *isec,
+                              const char *iext)
+{
+	if (loc->sec != isec)
+		return false;
+	return !iext || loc->ext == iext ||
+	       STREQ (iext, loc->ext + strlen (isec));
+}
+
 /* Look for a page in the database. If db not accessible, return -1,
    otherwise return number of pages found. */
 static int try_db (const char *manpath, const char *sec, const char *name,
@@ -3509,6 +3644,8 @@ static int try_db (const char *manpath, const char *sec, const char *name,
 	struct mandata *loc;
 	char *catpath, *database;
 	MYDBM_FILE dbf = NULL;
+	const char *isec = intern_string (sec);
+	const char *iext = intern_string (extension);
 	int found = 0;
 #ifdef MAN_DB_UPDATES
 	bool found_stale = false;
@@ -3523,10 +3660,28 @@ static int try_db (const char *manpath, const char *sec, const char *name,
 	if (!db_map)
 		db_map = new_string_map (GL_HASH_MAP, db_map_value_free);
 
+	/* The lookup cache may be able to tell us that the database has
+	 * nothing under this name, without our having to open it.
+	 */
+	if (!regex_opt && !wildcard &&
+	    !gl_map_search (db_map, manpath, (const void **) &matches)) {
+		const struct lookup_cache *cache = get_lookup_cache (manpath);
+
+		if (cache && !lookup_cache_has_key (cache, name)) {
+			debug ("%s is not in the lookup cache for %s\n", name,
+			       manpath);
+			matches = gl_list_create_empty (
+			        GL_ARRAY_LIST, NULL, NULL,
+			        (gl_listelement_dispose_fn) free_mandata_struct,
+			        true);
+			gl_map_put (db_map, xstrdup (manpath), matches);
+		}
+	}
+
 	/* If we haven't looked here already, do so now. */
 	if (!gl_map_search (db_map, manpath, (const void **) &matches)) {
-		dbf = MYDBM_NEW (database);
-		if (MYDBM_RDOPEN (dbf) && !dbver_rd (dbf)) {
+		dbf = dbcache_open (database);
+		if (dbf) {
 			debug ("Succeeded in opening %s O_RDONLY\n", database);
 
 			/* if section is set, only return those that match,
@@ -3571,14 +3726,17 @@ static int try_db (const char *manpath, const char *sec, const char *name,
 	 * caller should try again.
 	 */
 	GL_LIST_FOREACH (matches, loc)
-		if (STREQ (sec, loc->sec) &&
-		    (!extension || STREQ (extension, loc->ext) ||
-		     STREQ (extension, loc->ext + strlen (sec))))
+		if (db_entry_matches (loc, isec, iext))
 			if (maybe_update_file (manpath, name, loc))
 				found_stale = true;
 
 	if (found_stale) {
 		gl_map_remove (db_map, manpath);
+		/* The database has changed, so check the lookup cache
+		 * again too.
+		 */
+		if (lookup_map)
+			gl_map_remove (lookup_map, manpath);
 		found = TRY_DATABASE_UPDATED;
 		goto out;
 	}
@@ -3587,14 +3745,11 @@ static int try_db (const char *manpath, const char *sec, const char *name,
 	/* cycle through the mandata structures (there's usually only
 	   1 or 2) and see what we have w.r.t. the current section */
 	GL_LIST_FOREACH (matches, loc)
-		if (STREQ (sec, loc->sec) &&
-		    (!extension || STREQ (extension, loc->ext) ||
-		     STREQ (extension, loc->ext + strlen (sec))))
+		if (db_entry_matches (loc, isec, iext))
 			found += add_candidate (cand_head, CANDIDATE_DATABASE,
 			                        0, name, manpath, NULL, loc);
 
 out:
-	MYDBM_FREE (dbf);
 	free (database);
 	free (catpath);
 	return found;
@@ -3656,6 +3811,11 @@ static int display_pages (struct candidate *candidates)
 	struct candidate *candp;
 	int found = 0;
 
+	/* Our lookups are done.  Don't hold readers' locks on databases
+	 * while the user reads pages, or mandb would have to wait for us.
+	 */
+	dbcache_close_all ();
+
 	for (candp = candidates; candp; candp = candp->next) {
 		global_manpath = is_global_mandir (candp->path);
 		if (!global_manpath)
@@ -3742,6 +3902,7 @@ static int do_global_apropos_section (const char *path, const char *sec,
 	int found = 0;
 	gl_list_t names;
 	const char *found_name;
+	struct file_order *order;
 	regex_t search;
 
 	global_manpath = is_global_mandir (path);
@@ -3759,7 +3920,7 @@ static int do_global_apropos_section (const char *path, const char *sec,
 	else
 		memset (&search, 0, sizeof search);
 
-	order_files (path, &names);
+	order = order_files (path, &names);
 
 	GL_LIST_FOREACH (names, found_name) {
 		struct mandata *info;
@@ -3767,6 +3928,7 @@ static int do_global_apropos_section (const char *path, const char *sec,
 		const struct ult_value *man_ult;
 		char *cat_file = NULL;
 
+		order_files_next (order);
 		if (!grep (found_name, name, &search))
 			continue;
 
@@ -3794,6 +3956,7 @@ next:
 		free_mandata_struct (info);
 	}
 
+	order_files_free (order);
 	gl_list_free (names);
 
 	if (regex_opt)
@@ -4163,11 +4326,207 @@ static char *sh_lang_first_word (const char *cmd)
 	return ret;
 }
 
+/* Look for each of the pages named in ARGV, starting at first_arg. */
+static int process_args (int argc, char *argv[])
+{
+	int exit_status = OK;
+	const char *tmp;
+
+	while (first_arg < argc) {
+		int status = OK;
+		int found = 0;
+		static bool maybe_section = false;
+		const char *nextarg = argv[first_arg++];
+
+		/*
+		 * See if this argument is a valid section name.  If not,
+		 * is_section returns NULL.
+		 */
+		if (!catman) {
+			tmp = is_section (nextarg);
+			if (tmp) {
+				section = tmp;
+				debug ("\nsection: %s\n", section);
+				maybe_section = true;
+			}
+		}
+
+		if (maybe_section) {
+			if (first_arg < argc)
+				/* e.g. 'man 3perl Shell' */
+				nextarg = argv[first_arg++];
+			else
+				/* e.g. 'man 9wm' */
+				section = NULL;
+			/* ... but leave maybe_section set so we can
+			 * tell later that this happened.
+			 */
+		}
+
+		/* this is where we actually start looking for the man page */
+		skip = false;
+		if (global_apropos)
+			status = do_global_apropos (nextarg, &found);
+		else {
+			bool found_subpage = false;
+			if (subpages && first_arg < argc) {
+				char *subname = xasprintf ("%s-%s", nextarg,
+				                           argv[first_arg]);
+				assert (subname);
+				status = man (subname, &found);
+				free (subname);
+				if (status == OK) {
+					found_subpage = true;
+					++first_arg;
+				}
+			}
+			if (!found_subpage && subpages && first_arg < argc) {
+				char *subname = xasprintf ("%s_%s", nextarg,
+				                           argv[first_arg]);
+				assert (subname);
+				status = man (subname, &found);
+				free (subname);
+				if (status == OK) {
+					found_subpage = true;
+					++first_arg;
+				}
+			}
+			if (!found_subpage)
+				status = man_maybe_local (nextarg, &found);
+		}
+
+		/* clean out the cache of database lookups for each man page */
+		if (db_map) {
+			gl_map_free (db_map);
+			db_map = NULL;
+		}
+
+		if (section && maybe_section) {
+			if (status != OK && !catman) {
+				/* Maybe the section wasn't a section after
+				 * all? e.g. 'man 9wm fvwm'.
+				 */
+				bool found_subpage = false;
+				debug ("\nRetrying section %s as name\n",
+				       section);
+				tmp = section;
+				section = NULL;
+				if (subpages) {
+					char *subname = xasprintf (
+					        "%s-%s", tmp, nextarg);
+					status = man (subname, &found);
+					free (subname);
+					if (status == OK) {
+						found_subpage = true;
+						++first_arg;
+					}
+				}
+				if (!found_subpage)
+					status = man_maybe_local (tmp, &found);
+				if (db_map) {
+					gl_map_free (db_map);
+					db_map = NULL;
+				}
+				/* ... but don't gripe about it if it doesn't
+				 * work!
+				 */
+				if (status == OK) {
+					/* It was a name after all, so arrange
+					 * to try the next page again with a
+					 * null section.
+					 */
+					nextarg = tmp;
+					--first_arg;
+				} else
+					/* No go, it really was a section. */
+					section = tmp;
+			}
+		}
+
+		if (status != OK && !catman) {
+			if (!skip) {
+				exit_status = status;
+				if (exit_status == NOT_FOUND) {
+					if (!section && maybe_section &&
+					    CTYPE (isdigit, nextarg[0]))
+						gripe_no_name (nextarg);
+					else
+						gripe_no_man (nextarg,
+						              section);
+				}
+			}
+		} else {
+			debug ("\nFound %d man pages\n", found);
+			if (catman) {
+				printf ("%s", nextarg);
+				if (section)
+					printf ("(%s)", section);
+				if (first_arg != argc)
+					fputs (", ", stdout);
+				else
+					fputs (".\n", stdout);
+			}
+		}
+
+		maybe_section = false;
+	}
+	if (db_map) {
+		gl_map_free (db_map);
+		db_map = NULL;
+	}
+
+	return exit_status;
+}
+
+/* Read queries from standard input, one per line, each in the same form
+ * as the non-option command-line arguments.  The answers to each query
+ * are followed by an empty line, and flushed at once, so that callers
+ * can use a single man process to resolve many queries.  Caches of
+ * directory contents and database handles are kept for the lifetime of
+ * the process, but lookup caches are checked again before each query.
+ */
+static int process_batch (void)
+{
+	const char *batch_section = section;
+	char *line = NULL;
+	size_t len = 0;
+	char **words = NULL;
+	size_t words_max = 0;
+	int exit_status = OK;
+
+	while (getline (&line, &len, stdin) != -1) {
+		size_t nwords = 0;
+		char *word;
+		int status;
+
+		for (word = strtok (line, " \t\n"); word;
+		     word = strtok (NULL, " \t\n")) {
+			if (nwords + 1 >= words_max)
+				words = x2nrealloc (words, &words_max,
+				                    sizeof *words);
+			words[nwords++] = word;
+		}
+
+		section = batch_section;
+		first_arg = 0;
+		revalidate_lookup_caches ();
+		status = process_args ((int) nwords, words);
+		if (status != OK)
+			exit_status = status;
+
+		putchar ('\n');
+		fflush (stdout);
+	}
+
+	free (words);
+	free (line);
+	return exit_status;
+}
+
 int main (int argc, char *argv[])
 {
 	int argc_env, exit_status = OK;
 	char **argv_env;
-	const char *tmp;
 
 	set_program_name (argv[0]);
 
@@ -4290,7 +4649,12 @@ int main (int argc, char *argv[])
 
 	debug ("using %s as pager\n", pager);
 
-	if (first_arg == argc) {
+	if (batch) {
+		if (first_arg < argc)
+			error (FAIL, 0,
+			       _ ("--batch reads page names from standard "
+			          "input"));
+	} else if (first_arg == argc) {
 		if (print_where) {
 			manp = get_manpath ("");
 			printf ("%s\n", manp);
@@ -4336,151 +4700,14 @@ int main (int argc, char *argv[])
 	}
 #endif /* MAN_DB_UPDATES */
 
-	while (first_arg < argc) {
-		int status = OK;
-		int found = 0;
-		static bool maybe_section = false;
-		const char *nextarg = argv[first_arg++];
-
-		/*
-		 * See if this argument is a valid section name.  If not,
-		 * is_section returns NULL.
-		 */
-		if (!catman) {
-			tmp = is_section (nextarg);
-			if (tmp) {
-				section = tmp;
-				debug ("\nsection: %s\n", section);
-				maybe_section = true;
-			}
-		}
-
-		if (maybe_section) {
-			if (first_arg < argc)
-				/* e.g. 'man 3perl Shell' */
-				nextarg = argv[first_arg++];
-			else
-				/* e.g. 'man 9wm' */
-				section = NULL;
-			/* ... but leave maybe_section set so we can
-			 * tell later that this happened.
-			 */
-		}
-
-		/* this is where we actually start looking for the man page */
-		skip = false;
-		if (global_apropos)
-			status = do_global_apropos (nextarg, &found);
-		else {
-			bool found_subpage = false;
-			if (subpages && first_arg < argc) {
-				char *subname = xasprintf ("%s-%s", nextarg,
-				                           argv[first_arg]);
-				assert (subname);
-				status = man (subname, &found);
-				free (subname);
-				if (status == OK) {
-					found_subpage = true;
-					++first_arg;
-				}
-			}
-			if (!found_subpage && subpages && first_arg < argc) {
-				char *subname = xasprintf ("%s_%s", nextarg,
-				                           argv[first_arg]);
-				assert (subname);
-				status = man (subname, &found);
-				free (subname);
-				if (status == OK) {
-					found_subpage = true;
-					++first_arg;
-				}
-			}
-			if (!found_subpage)
-				status = man_maybe_local (nextarg, &found);
-		}
-
-		/* clean out the cache of database lookups for each man page */
-		if (db_map) {
-			gl_map_free (db_map);
-			db_map = NULL;
-		}
-
-		if (section && maybe_section) {
-			if (status != OK && !catman) {
-				/* Maybe the section wasn't a section after
-				 * all? e.g. 'man 9wm fvwm'.
-				 */
-				bool found_subpage = false;
-				debug ("\nRetrying section %s as name\n",
-				       section);
-				tmp = section;
-				section = NULL;
-				if (subpages) {
-					char *subname = xasprintf (
-					        "%s-%s", tmp, nextarg);
-					status = man (subname, &found);
-					free (subname);
-					if (status == OK) {
-						found_subpage = true;
-						++first_arg;
-					}
-				}
-				if (!found_subpage)
-					status = man_maybe_local (tmp, &found);
-				if (db_map) {
-					gl_map_free (db_map);
-					db_map = NULL;
-				}
-				/* ... but don't gripe about it if it doesn't
-				 * work!
-				 */
-				if (status == OK) {
-					/* It was a name after all, so arrange
-					 * to try the next page again with a
-					 * null section.
-					 */
-					nextarg = tmp;
-					--first_arg;
-				} else
-					/* No go, it really was a section. */
-					section = tmp;
-			}
-		}
-
-		if (status != OK && !catman) {
-			if (!skip) {
-				exit_status = status;
-				if (exit_status == NOT_FOUND) {
-					if (!section && maybe_section &&
-					    CTYPE (isdigit, nextarg[0]))
-						gripe_no_name (nextarg);
-					else
-						gripe_no_man (nextarg,
-						              section);
-				}
-			}
-		} else {
-			debug ("\nFound %d man pages\n", found);
-			if (catman) {
-				printf ("%s", nextarg);
-				if (section)
-					printf ("(%s)", section);
-				if (first_arg != argc)
-					fputs (", ", stdout);
-				else
-					fputs (".\n", stdout);
-			}
-		}
-
-		maybe_section = false;
-	}
-	if (db_map) {
-		gl_map_free (db_map);
-		db_map = NULL;
-	}
+	if (batch)
+		exit_status = process_batch ();
+	else
+		exit_status = process_args (argc, argv);
 
 	drop_effective_privs ();
 
+	dbcache_close_all ();
 	gl_list_free (section_list);
 	free_pathlist (manpathlist);
 	free (internal_locale);
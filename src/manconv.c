@@ -49,7 +49,9 @@
 #include "argp.h"
 #include "attribute.h"
 #include "error.h"
+#include "gl_hash_map.h"
 #include "gl_list.h"
+#include "gl_xmap.h"
 #include "xalloc.h"
 #include "xstrndup.h"
 #include "xvasprintf.h"
@@ -66,6 +68,7 @@
 
 #include "decompress.h"
 #include "manconv.h"
+#include "utf8.h"
 
 /* Encoding conversions from groff-1.20/src/preproc/preconv/preconv.cpp.
  * I've only included those not already recognised by GNU libiconv.
@@ -222,6 +225,50 @@ char *check_preprocessor_encoding (decompress *decomp, const char *to_encoding,
 	return pp_encoding;
 }
 
+struct manconv_context {
+#ifdef HAVE_ICONV
+	/* Maps "TO\tFROM" to struct cached_iconv. */
+	gl_map_t descriptors;
+#endif /* HAVE_ICONV */
+	char *utf8, *output;
+};
+
+#ifdef HAVE_ICONV
+struct cached_iconv {
+	iconv_t cd;
+};
+
+static void cached_iconv_free (const void *value)
+{
+	struct cached_iconv *cached = (struct cached_iconv *) value;
+
+	iconv_close (cached->cd);
+	free (cached);
+}
+#endif /* HAVE_ICONV */
+
+struct manconv_context *manconv_context_new (void)
+{
+	struct manconv_context *ctx = XZALLOC (struct manconv_context);
+
+#ifdef HAVE_ICONV
+	ctx->descriptors = new_string_map (GL_HASH_MAP, cached_iconv_free);
+#endif /* HAVE_ICONV */
+	return ctx;
+}
+
+void manconv_context_free (struct manconv_context *ctx)
+{
+	if (!ctx)
+		return;
+#ifdef HAVE_ICONV
+	gl_map_free (ctx->descriptors);
+#endif /* HAVE_ICONV */
+	free (ctx->utf8);
+	free (ctx->output);
+	free (ctx);
+}
+
 static int add_output (const char *inbuf, size_t inlen,
                        struct manconv_outbuf *outbuf)
 {
@@ -247,13 +294,44 @@ static int add_output (const char *inbuf, size_t inlen,
 
 #ifdef HAVE_ICONV
 
+/* Return an iconv descriptor from FROMCODE to TOCODE, in its initial state.
+ * Descriptors are cached in CTX, and must not be closed by the caller.
+ * Returns (iconv_t) -1 and sets errno on failure.
+ */
+static iconv_t get_iconv (struct manconv_context *ctx, const char *tocode,
+                          const char *fromcode)
+{
+	char *key = xasprintf ("%s\t%s", tocode, fromcode);
+	struct cached_iconv *cached;
+	iconv_t cd;
+
+	if (gl_map_search (ctx->descriptors, key, (const void **) &cached)) {
+		free (key);
+		iconv (cached->cd, NULL, NULL, NULL, NULL);
+		return cached->cd;
+	}
+
+	cd = iconv_open (tocode, fromcode);
+	if (cd == (iconv_t) -1) {
+		int saved_errno = errno;
+		free (key);
+		errno = saved_errno;
+		return cd;
+	}
+	cached = XMALLOC (struct cached_iconv);
+	cached->cd = cd;
+	gl_map_put (ctx->descriptors, key, cached);
+	return cd;
+}
+
 /* When converting text containing an invalid multibyte sequence to
  * UTF-8//IGNORE, GNU libc's iconv returns EILSEQ but sets *inbuf to the end
  * of the input buffer.  I'm not sure whether this is a bug or not (it seems
  * to contradict the documentation), but work around it anyway by recoding
  * to UTF-8 so that we can accurately position the error.
  */
-static off_t locate_error (const char *try_from_code, const char *input,
+static off_t locate_error (struct manconv_context *ctx,
+                           const char *try_from_code, const char *input,
                            size_t input_size, char *utf8, size_t utf8_size)
 {
 	iconv_t cd_utf8_strict;
@@ -262,7 +340,7 @@ static off_t locate_error (const char *try_from_code, const char *input,
 	size_t n;
 	off_t ret;
 
-	cd_utf8_strict = iconv_open ("UTF-8", try_from_code);
+	cd_utf8_strict = get_iconv (ctx, "UTF-8", try_from_code);
 	if (cd_utf8_strict == (iconv_t) -1) {
 		error (0, errno, "iconv_open (\"UTF-8\", \"%s\")",
 		       try_from_code);
@@ -276,38 +354,242 @@ static off_t locate_error (const char *try_from_code, const char *input,
 	else
 		ret = 0;
 
-	iconv_close (cd_utf8_strict);
-
 	return ret;
 }
 
+/* Peek at up to *SIZE bytes of input.  A single peek may return less than
+ * is available, so repeat until we have either a full buffer or EOF/error.
+ */
+static const char *peek_window (decompress *decomp, size_t *size)
+{
+	size_t want = *size;
+	const char *input;
+
+	input = decompress_peek (decomp, size);
+	while (*size < want) {
+		size_t old_size = *size;
+		*size = want;
+		input = decompress_peek (decomp, size);
+		if (*size == old_size)
+			break;
+	}
+	return input;
+}
+
+static bool ATTRIBUTE_PURE is_utf8 (const char *code)
+{
+	return !strcasecmp (code, "UTF-8") || !strcasecmp (code, "UTF8");
+}
+
+/* What a single pass over the start of the input tells us about which
+ * candidate encodings can possibly succeed.
+ */
+struct input_profile {
+	enum { UTF8_VALID, UTF8_INVALID, UTF8_UNKNOWN } utf8;
+	/* Number of times each byte occurs. */
+	size_t counts[256];
+	size_t high_bytes;
+};
+
+static void profile_input (decompress *decomp, struct input_profile *profile)
+{
+	size_t size, i, valid;
+	const unsigned char *input;
+	bool complete;
+
+	/* In-process decompressors hold the whole input, so we may as well
+	 * look at all of it.
+	 */
+	if (decompress_is_pipeline (decomp))
+		size = 65536;
+	else
+		size = decompress_inprocess_len (decomp);
+	input = (const unsigned char *) peek_window (decomp, &size);
+	complete = !decompress_is_pipeline (decomp) || size < 65536;
+
+	memset (profile, 0, sizeof *profile);
+	for (i = 0; i < size; ++i)
+		++profile->counts[input[i]];
+	for (i = 0x80; i < 0x100; ++i)
+		profile->high_bytes += profile->counts[i];
+
+	if (!profile->high_bytes)
+		profile->utf8 = UTF8_VALID;
+	else {
+		valid = utf8_valid_prefix ((const char *) input, size);
+		if (valid == size)
+			profile->utf8 = UTF8_VALID;
+		else if (!input[valid] || (!complete && size - valid < 4))
+			/* iconv accepts NUL bytes, and a window may end
+			 * part-way through a character.
+			 */
+			profile->utf8 = UTF8_UNKNOWN;
+		else
+			profile->utf8 = UTF8_INVALID;
+	}
+
+	debug ("input profile: %zu bytes, %zu non-ASCII, UTF-8 %s\n", size,
+	       profile->high_bytes,
+	       profile->utf8 == UTF8_VALID     ? "valid"
+	       : profile->utf8 == UTF8_INVALID ? "invalid"
+	                                       : "unknown");
+}
+
+/* Map of encoding names to arrays of 256 bools, true for each byte that
+ * can never appear in text in that encoding.
+ */
+static gl_map_t forbidden_bytes_map;
+
+/* Ask iconv which non-ASCII bytes are invalid on their own in CODE.  For
+ * single-byte encodings this is exactly the set of undefined bytes.  In
+ * multibyte encodings, a byte that is invalid on its own may still follow
+ * another byte within a character, so nothing can be ruled out by byte;
+ * we recognise these because some byte reports an incomplete sequence.
+ * Returns NULL if CODE is multibyte or unknown to iconv.
+ */
+static const bool *forbidden_bytes (const char *code)
+{
+	const bool *cached;
+	bool *forbidden;
+	iconv_t cd;
+	bool multibyte = false;
+	int i;
+
+	if (!forbidden_bytes_map)
+		forbidden_bytes_map = new_string_map (GL_HASH_MAP, plain_free);
+	if (gl_map_search (forbidden_bytes_map, code,
+	                   (const void **) &cached))
+		return cached;
+
+	cd = iconv_open ("UTF-8", code);
+	if (cd == (iconv_t) -1)
+		forbidden = NULL;
+	else {
+		forbidden = XCALLOC (256, bool);
+		for (i = 0x80; i < 0x100; ++i) {
+			char in = (char) i, out[16];
+			char *inptr = &in, *outptr = out;
+			size_t inleft = 1, outleft = sizeof out;
+
+			if (iconv (cd, (ICONV_CONST char **) &inptr, &inleft,
+			           &outptr, &outleft) == (size_t) -1) {
+				if (errno == EILSEQ)
+					forbidden[i] = true;
+				else if (errno == EINVAL)
+					multibyte = true;
+			}
+			iconv (cd, NULL, NULL, NULL, NULL);
+		}
+		iconv_close (cd);
+		if (multibyte) {
+			free (forbidden);
+			forbidden = NULL;
+		}
+	}
+
+	gl_map_put (forbidden_bytes_map, xstrdup (code), forbidden);
+	return forbidden;
+}
+
+/* Could converting from CODE possibly succeed, given PROFILE? */
+static bool candidate_possible (const struct input_profile *profile,
+                                const char *code)
+{
+	const bool *forbidden;
+	int i;
+
+	if (is_utf8 (code))
+		return profile->utf8 != UTF8_INVALID;
+	if (!profile->high_bytes)
+		return true;
+
+	forbidden = forbidden_bytes (code);
+	if (!forbidden)
+		return true;
+	for (i = 0x80; i < 0x100; ++i)
+		if (profile->counts[i] && forbidden[i])
+			return false;
+	return true;
+}
+
+/* Return true if the SIZE bytes at TAIL could be the start of a UTF-8
+ * sequence that continues beyond them.
+ */
+static bool ATTRIBUTE_PURE incomplete_utf8 (const char *tail, size_t size)
+{
+	const unsigned char *p = (const unsigned char *) tail;
+	size_t need, i;
+
+	if (!size)
+		return false;
+	if (p[0] >= 0xC2 && p[0] <= 0xDF)
+		need = 2;
+	else if (p[0] >= 0xE0 && p[0] <= 0xEF)
+		need = 3;
+	else if (p[0] >= 0xF0 && p[0] <= 0xF4)
+		need = 4;
+	else
+		return false;
+	if (size >= need)
+		return false;
+	for (i = 1; i < size; ++i)
+		if ((p[i] & 0xC0) != 0x80)
+			return false;
+	return true;
+}
+
+/* When converting from UTF-8 to UTF-8, text that is already valid needs no
+ * conversion at all.  Write out as much of the window at INPUT as we can
+ * without changing what the caller would otherwise have done: either the
+ * whole window if it is valid, or all but an incomplete character at the
+ * end of a full window.  Returns the number of bytes written, 0 if the
+ * window needs iconv after all, or -1 if writing failed.
+ */
+static ssize_t pass_through_utf8 (const char *input, size_t input_size,
+                                  size_t buf_size,
+                                  struct manconv_outbuf *outbuf)
+{
+	size_t valid = utf8_valid_prefix (input, input_size);
+
+	if (!valid)
+		return 0;
+	if (valid < input_size &&
+	    (input_size < buf_size ||
+	     !incomplete_utf8 (input + valid, input_size - valid)))
+		return 0;
+	if (add_output (input, valid, outbuf) != 0)
+		return -1;
+	return valid;
+}
+
 typedef enum {
 	TRIED_ICONV_OK = 0,
 	TRIED_ICONV_ERROR = -1, /* can continue with another encoding */
 	TRIED_ICONV_FATAL = -2  /* must give up */
 } tried_iconv;
 
-static tried_iconv try_iconv (decompress *decomp, const char *try_from_code,
-                              const char *to, bool last,
-                              struct manconv_outbuf *outbuf)
+static tried_iconv try_iconv (struct manconv_context *ctx, decompress *decomp,
+                              const char *try_from_code, const char *to,
+                              bool last, struct manconv_outbuf *outbuf)
 {
 	char *try_to_code = xstrdup (to);
 	static const size_t buf_size = 65536;
 	size_t input_size = buf_size;
 	off_t input_pos = 0;
 	const char *input;
-	static char *utf8 = NULL, *output = NULL;
+	char *utf8, *output;
 	size_t utf8left = 0;
 	iconv_t cd_utf8, cd = NULL;
 	bool to_utf8 = STREQ (try_to_code, "UTF-8") ||
 	               STRNEQ (try_to_code, "UTF-8//", 7);
 	const char *utf8_target = last ? "UTF-8//IGNORE" : "UTF-8";
 	bool ignore_errors = (strstr (try_to_code, "//IGNORE") != NULL);
+	bool pass_through = to_utf8 && is_utf8 (try_from_code);
 	tried_iconv ret = TRIED_ICONV_OK;
 
 	debug ("trying encoding %s -> %s\n", try_from_code, try_to_code);
 
-	cd_utf8 = iconv_open (utf8_target, try_from_code);
+	cd_utf8 = get_iconv (ctx, utf8_target, try_from_code);
 	if (cd_utf8 == (iconv_t) -1) {
 		error (0, errno, "iconv_open (\"%s\", \"%s\")", utf8_target,
 		       try_from_code);
@@ -316,7 +598,7 @@ static tried_iconv try_iconv (decompress *decomp, const char *try_from_code,
 	}
 
 	if (!to_utf8) {
-		cd = iconv_open (try_to_code, "UTF-8");
+		cd = get_iconv (ctx, try_to_code, "UTF-8");
 		if (cd == (iconv_t) -1) {
 			error (0, errno, "iconv_open (\"%s\", \"UTF-8\")",
 			       try_to_code);
@@ -325,24 +607,14 @@ static tried_iconv try_iconv (decompress *decomp, const char *try_from_code,
 		}
 	}
 
-	input = decompress_peek (decomp, &input_size);
-	if (input_size < buf_size) {
-		/* End of file, error, or just a short read? Repeat until we
-		 * have either a full buffer or EOF/error.
-		 */
-		while (input_size < buf_size) {
-			size_t old_input_size = input_size;
-			input_size = buf_size;
-			input = decompress_peek (decomp, &input_size);
-			if (input_size == old_input_size)
-				break;
-		}
-	}
+	input = peek_window (decomp, &input_size);
 
-	if (!utf8)
-		utf8 = xmalloc (buf_size);
-	if (!output)
-		output = xmalloc (buf_size);
+	if (!ctx->utf8)
+		ctx->utf8 = xmalloc (buf_size);
+	if (!ctx->output)
+		ctx->output = xmalloc (buf_size);
+	utf8 = ctx->utf8;
+	output = ctx->output;
 
 	while (input_size || utf8left) {
 		int handle_iconv_errors = 0;
@@ -350,6 +622,22 @@ static tried_iconv try_iconv (decompress *decomp, const char *try_from_code,
 		size_t inleft = input_size, outleft;
 		size_t n, n2 = -1;
 
+		if (pass_through && !utf8left) {
+			ssize_t passed = pass_through_utf8 (input, input_size,
+			                                    buf_size, outbuf);
+
+			if (passed < 0) {
+				ret = TRIED_ICONV_FATAL;
+				goto out;
+			} else if (passed > 0) {
+				decompress_peek_skip (decomp, passed);
+				input_pos += passed;
+				input_size = buf_size;
+				input = peek_window (decomp, &input_size);
+				continue;
+			}
+		}
+
 		if (!utf8left) {
 			/* First, convert the text to UTF-8. By assumption,
 			 * all validly-encoded text can be converted to
@@ -447,7 +735,7 @@ static tried_iconv try_iconv (decompress *decomp, const char *try_from_code,
 				if (!quiet) {
 					error_pos = input_pos +
 					            locate_error (
-					                    try_from_code,
+					                    ctx, try_from_code,
 					                    input, input_size,
 					                    utf8, buf_size);
 					error (0, handle_iconv_errors,
@@ -460,7 +748,7 @@ static tried_iconv try_iconv (decompress *decomp, const char *try_from_code,
 				if (!quiet) {
 					error_pos = input_pos +
 					            locate_error (
-					                    try_from_code,
+					                    ctx, try_from_code,
 					                    input, input_size,
 					                    utf8, buf_size);
 					error (0, 0, "byte %jd: %s", error_pos,
@@ -485,28 +773,18 @@ static tried_iconv try_iconv (decompress *decomp, const char *try_from_code,
 		 */
 		if (!utf8left) {
 			input_size = buf_size;
-			input = decompress_peek (decomp, &input_size);
-			while (input_size < buf_size) {
-				size_t old_input_size = input_size;
-				input_size = buf_size;
-				input = decompress_peek (decomp, &input_size);
-				if (input_size == old_input_size)
-					break;
-			}
+			input = peek_window (decomp, &input_size);
 		}
 	}
 
 out:
-	if (!to_utf8)
-		iconv_close (cd);
-	iconv_close (cd_utf8);
 	free (try_to_code);
 
 	return ret;
 }
 
-int manconv (decompress *decomp, gl_list_t from, const char *to,
-             struct manconv_outbuf *outbuf)
+int manconv (struct manconv_context *ctx, decompress *decomp, gl_list_t from,
+             const char *to, struct manconv_outbuf *outbuf)
 {
 	char *pp_encoding;
 	const char *try_from_code;
@@ -526,14 +804,29 @@ int manconv (decompress *decomp, gl_list_t from, const char *to,
 				goto out;
 			}
 		}
-		tried = try_iconv (decomp, pp_encoding, to, 1, outbuf);
+		tried = try_iconv (ctx, decomp, pp_encoding, to, 1, outbuf);
 		if (tried == TRIED_ICONV_FATAL)
 			ret = -1;
 	} else {
+		struct input_profile profile;
+		bool profiled = gl_list_size (from) > 1;
+
+		/* Rule out candidates that cannot possibly work before
+		 * trying any of them, rather than converting the input only
+		 * to throw the result away.
+		 */
+		if (profiled)
+			profile_input (decomp, &profile);
 		GL_LIST_FOREACH (from, try_from_code) {
 			bool last = !gl_list_next_node (from, from_node);
-			tried = try_iconv (decomp, try_from_code, to, last,
-			                   outbuf);
+			if (profiled && !last &&
+			    !candidate_possible (&profile, try_from_code)) {
+				debug ("ruling out encoding %s\n",
+				       try_from_code);
+				continue;
+			}
+			tried = try_iconv (ctx, decomp, try_from_code, to,
+			                   last, outbuf);
 			if (tried == TRIED_ICONV_OK)
 				break;
 			else if (tried == TRIED_ICONV_FATAL) {
@@ -555,8 +848,9 @@ out:
 /* If we don't have iconv, there isn't much we can do; just pass everything
  * through unchanged.
  */
-int manconv (decompress *decomp, gl_list_t from MAYBE_UNUSED,
-             const char *to MAYBE_UNUSED, struct manconv_outbuf *outbuf)
+int manconv (struct manconv_context *ctx MAYBE_UNUSED, decompress *decomp,
+             gl_list_t from MAYBE_UNUSED, const char *to MAYBE_UNUSED,
+             struct manconv_outbuf *outbuf)
 {
 	for (;;) {
 		size_t len = 4096;
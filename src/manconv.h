@@ -29,7 +29,16 @@ struct manconv_outbuf {
 	size_t len, max;
 };
 
+/* A conversion context caches iconv descriptors and owns the buffers used
+ * during conversion, so that converting many pages in turn can reuse them.
+ * Concurrent conversions each need their own context.
+ */
+struct manconv_context;
+
+struct manconv_context *manconv_context_new (void);
+void manconv_context_free (struct manconv_context *ctx);
+
 char *check_preprocessor_encoding (decompress *decomp, const char *to_code,
                                    char **modified_line);
-int manconv (decompress *decomp, gl_list_t from, const char *to,
-             struct manconv_outbuf *outbuf);
+int manconv (struct manconv_context *ctx, decompress *decomp, gl_list_t from,
+             const char *to, struct manconv_outbuf *outbuf);
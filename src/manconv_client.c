@@ -28,6 +28,7 @@
 #include <string.h>
 #include <unistd.h>
 
+#include "attribute.h"
 #include "gl_array_list.h"
 #include "gl_xlist.h"
 #include "xalloc.h"
@@ -38,6 +39,7 @@
 #include "pipeline.h"
 
 #include "appendstr.h"
+#include "cleanup.h"
 #include "glcontainers.h"
 #include "sandbox.h"
 #include "security.h"
@@ -52,6 +54,26 @@ struct manconv_codes {
 	char *to;
 };
 
+/* Conversions done by this process share one context, so that the iconv
+ * descriptors for a given pair of encodings are only set up once.
+ */
+static struct manconv_context *context;
+
+static void free_context (void *data MAYBE_UNUSED)
+{
+	manconv_context_free (context);
+	context = NULL;
+}
+
+static struct manconv_context *get_context (void)
+{
+	if (!context) {
+		context = manconv_context_new ();
+		push_cleanup (free_context, NULL, 0);
+	}
+	return context;
+}
+
 static void manconv_stdin (void *data)
 {
 	struct manconv_codes *codes = data;
@@ -59,7 +81,8 @@ static void manconv_stdin (void *data)
 
 	decomp = decompress_fdopen (dup (STDIN_FILENO));
 	decompress_start (decomp);
-	if (manconv (decomp, codes->from, codes->to, NULL) != 0)
+	if (manconv (get_context (), decomp, codes->from, codes->to, NULL) !=
+	    0)
 		/* manconv already wrote an error message to stderr.  Just
 		 * exit non-zero.
 		 */
@@ -198,7 +221,7 @@ int manconv_inprocess (decompress *d, const char *source_encoding,
 	outbuf.max = decompress_inprocess_len (d) * 4;
 	outbuf.buf = xmalloc (outbuf.max);
 
-	if (manconv (d, from, to, &outbuf) == 0)
+	if (manconv (get_context (), d, from, to, &outbuf) == 0)
 		decompress_inprocess_replace (d, outbuf.buf, outbuf.len);
 	else {
 		/* manconv already wrote an error message to stderr.  Just
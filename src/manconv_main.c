@@ -144,6 +144,7 @@ static struct argp argp = {options, parse_opt, args_doc};
 int main (int argc, char *argv[])
 {
 	decompress *decomp;
+	struct manconv_context *ctx;
 
 	set_program_name (argv[0]);
 
@@ -190,11 +191,13 @@ int main (int argc, char *argv[])
 		free (lang);
 	}
 
-	if (manconv (decomp, from_code, to_code, NULL) != 0)
+	ctx = manconv_context_new ();
+	if (manconv (ctx, decomp, from_code, to_code, NULL) != 0)
 		/* manconv already wrote an error message to stderr.  Just
 		 * exit non-zero.
 		 */
 		exit (FATAL);
+	manconv_context_free (ctx);
 
 	free (to_code);
 	gl_list_free (from_code);
@@ -80,8 +80,10 @@
 #include "mydbm.h"
 
 #include "check_mandirs.h"
+#include "lookup_cache.h"
 #include "manp.h"
 #include "straycats.h"
+#include "whatis_cache.h"
 
 int quiet = 1;
 static char *manp;
@@ -509,7 +511,7 @@ static int update_one_file (MYDBM_FILE dbf, const char *manpath,
 		}
 		free_mandata_struct (info);
 
-		test_manfile (dbf, filename, manpath);
+		test_manfile (dbf, filename, manpath, NULL);
 	}
 
 	return 1;
@@ -610,6 +612,11 @@ static int mandb (struct dbpaths *dbpaths, const char *catpath,
 		}
 	}
 
+	/* When updating, keep cached whatis information for pages in
+	 * directories that we aren't going to look at this time.
+	 */
+	whatis_cache_load (catpath, !should_create);
+
 	if (!quiet)
 		printf (_ ("Processing manual pages under %s...\n"), manpath);
 
@@ -621,12 +628,48 @@ static int mandb (struct dbpaths *dbpaths, const char *catpath,
 	if (check_for_strays && dbf->file)
 		strays += straycats (dbf, manpath);
 
+	if (!opt_test && whatis_cache_save (catpath)) {
+#ifdef MAN_OWNER
+		if (global_manpath) {
+			char *name = whatis_cache_name (catpath);
+			chown_if_possible (name);
+			free (name);
+		}
+#endif /* MAN_OWNER */
+	}
+
 	MYDBM_FREE (dbf);
 	free (database);
 	free (dbname);
 	return amount;
 }
 
+/* Make sure that the lookup cache for this manpath is up to date. */
+static void update_lookup_cache (const char *manpath, const char *catpath,
+                                 bool global_manpath MAYBE_UNUSED)
+{
+	struct lookup_cache *cache;
+
+	cache = lookup_cache_open (manpath, catpath);
+	if (cache) {
+		bool current = lookup_cache_is_current (cache);
+
+		lookup_cache_close (cache);
+		if (current)
+			return;
+	}
+
+	if (lookup_cache_write (manpath, catpath)) {
+#ifdef MAN_OWNER
+		if (global_manpath) {
+			char *name = lookup_cache_name (catpath);
+			chown_if_possible (name);
+			free (name);
+		}
+#endif /* MAN_OWNER */
+	}
+}
+
 static int process_manpath (const char *manpath, bool global_manpath,
                             gl_map_t tried_catdirs)
 {
@@ -691,6 +734,8 @@ static int process_manpath (const char *manpath, bool global_manpath,
 #endif /* MAN_OWNER */
 			reorganize (catpath, global_manpath);
 		}
+		if (!opt_test)
+			update_lookup_cache (manpath, catpath, global_manpath);
 	}
 
 out:
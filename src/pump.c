@@ -0,0 +1,352 @@
+/*
+ * pump.c: zero-copy pumping between pipelines
+ *
+ * Copyright (C) 2024 Colin Watson.
+ *
+ * This file is part of man-db.
+ *
+ * man-db is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * man-db is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with man-db; if not, write to the Free Software Foundation,
+ * Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ */
+
+#ifdef HAVE_CONFIG_H
+#  include "config.h"
+#endif /* HAVE_CONFIG_H */
+
+#include <errno.h>
+#include <fcntl.h>
+#include <limits.h>
+#include <poll.h>
+#include <signal.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "pipeline.h"
+
+#include "manconfig.h"
+
+#include "debug.h"
+
+#include "pump.h"
+
+static void pump_rest (pipeline *source, pipeline *filter, pipeline *sink,
+                       pipeline *tee)
+{
+	if (filter && tee)
+		pipeline_pump (source, filter, sink, tee, nullptr);
+	else if (filter)
+		pipeline_pump (source, filter, sink, nullptr);
+	else if (tee)
+		pipeline_pump (source, sink, tee, nullptr);
+	else
+		pipeline_pump (source, sink, nullptr);
+}
+
+#if defined(HAVE_SPLICE) && defined(HAVE_TEE)
+
+/* The most we try to move in a single system call: the default pipe
+ * capacity on Linux.
+ */
+#  define PUMP_CHUNK 65536
+
+/* One hop in the chain: everything read from in is copied to each live
+ * element of out.  If both outputs are live, data is first tee'd into
+ * out[1] and then spliced into out[0]; pending counts bytes in the former
+ * state.
+ */
+struct pump_stage {
+	pipeline *in_p;
+	int in;
+	int out[2];
+	bool live[2];
+	size_t pending;
+	bool eof;
+};
+
+static int pump_stage_nlive (const struct pump_stage *s)
+{
+	return (int) s->live[0] + (int) s->live[1];
+}
+
+/* Signal end of file to this stage's sinks.  Their input descriptors
+ * belong to libpipeline, which will close them later, so rather than
+ * closing them ourselves we atomically replace them with /dev/null.
+ */
+static bool pump_stage_finish (struct pump_stage *s, int devnull)
+{
+	int i;
+
+	s->eof = true;
+	for (i = 0; i < 2; ++i) {
+		if (s->out[i] == -1)
+			continue;
+		if (dup3 (devnull, s->out[i], O_CLOEXEC) < 0)
+			return false;
+	}
+	return true;
+}
+
+/* Throw away bytes that were tee'd to out[1] but can no longer be
+ * delivered to out[0], so that they are not sent to out[1] twice.
+ */
+static bool pump_stage_discard_pending (struct pump_stage *s, int devnull)
+{
+	while (s->pending) {
+		ssize_t n = splice (s->in, NULL, devnull, NULL, s->pending, 0);
+		if (n <= 0) {
+			if (n < 0 && errno == EINTR)
+				continue;
+			return false;
+		}
+		s->pending -= n;
+	}
+	return true;
+}
+
+/* Move some data through a stage whose descriptors poll reported ready.
+ * Returns false if the fast path cannot continue and pipeline_pump should
+ * take over from here.
+ */
+static bool pump_stage_step (struct pump_stage *s, int devnull)
+{
+	size_t peeked = pipeline_peek_size (s->in_p);
+	ssize_t n;
+
+	if (peeked) {
+		/* Flush anything our caller peeked at before moving on to
+		 * data that is still in the kernel.  poll only promises
+		 * room for PIPE_BUF bytes.
+		 */
+		const char *buf;
+
+		if (peeked > PIPE_BUF)
+			peeked = PIPE_BUF;
+		buf = pipeline_peek (s->in_p, &peeked);
+		n = write (s->out[0], buf, peeked);
+		if (n < 0)
+			return errno == EAGAIN || errno == EINTR;
+		pipeline_peek_skip (s->in_p, (size_t) n);
+		return true;
+	}
+
+	if (s->pending) {
+		n = splice (s->in, NULL, s->out[0], NULL, s->pending,
+		            SPLICE_F_MOVE | SPLICE_F_NONBLOCK);
+		if (n < 0) {
+			if (errno == EAGAIN || errno == EINTR)
+				return true;
+			if (errno != EPIPE)
+				return false;
+			debug ("zero-copy pump: primary sink went away\n");
+			s->live[0] = false;
+			return pump_stage_discard_pending (s, devnull);
+		}
+		s->pending -= n;
+		return true;
+	}
+
+	if (s->live[0] && s->live[1]) {
+		n = tee (s->in, s->out[1], PUMP_CHUNK, SPLICE_F_NONBLOCK);
+		if (n < 0) {
+			if (errno == EAGAIN || errno == EINTR)
+				return true;
+			if (errno != EPIPE)
+				return false;
+			debug ("zero-copy pump: secondary sink went away\n");
+			s->live[1] = false;
+			return true;
+		} else if (n == 0)
+			return pump_stage_finish (s, devnull);
+		s->pending = n;
+		return true;
+	} else {
+		int i = s->live[0] ? 0 : 1;
+
+		n = splice (s->in, NULL, s->out[i], NULL, PUMP_CHUNK,
+		            SPLICE_F_MOVE | SPLICE_F_NONBLOCK);
+		if (n < 0) {
+			if (errno == EAGAIN || errno == EINTR)
+				return true;
+			if (errno == EPIPE)
+				s->live[i] = false;
+			/* Whatever happens now when nobody is listening is
+			 * pipeline_pump's business.
+			 */
+			return false;
+		} else if (n == 0)
+			return pump_stage_finish (s, devnull);
+		return true;
+	}
+}
+
+static void pump_stage_init (struct pump_stage *s, pipeline *in_p,
+                             pipeline *out0, pipeline *out1)
+{
+	s->in_p = in_p;
+	s->in = fileno (pipeline_get_outfile (in_p));
+	s->out[0] = fileno (pipeline_get_infile (out0));
+	s->live[0] = true;
+	if (out1) {
+		s->out[1] = fileno (pipeline_get_infile (out1));
+		s->live[1] = true;
+	} else {
+		s->out[1] = -1;
+		s->live[1] = false;
+	}
+	s->pending = 0;
+	s->eof = false;
+}
+
+/* Run the splice/tee loop.  Returns when all stages have reached end of
+ * file or as soon as something happens that we would rather leave to
+ * pipeline_pump.  In either case the pipelines are left in a consistent
+ * state for pipeline_pump to carry on from.
+ */
+static void pump_stages (struct pump_stage *stages, size_t nstages,
+                         int devnull)
+{
+	for (;;) {
+		struct pollfd fds[6];
+		size_t first[2], count[2];
+		nfds_t nfds = 0;
+		bool active = false;
+		size_t i, j;
+
+		for (i = 0; i < nstages; ++i) {
+			struct pump_stage *s = &stages[i];
+
+			first[i] = nfds;
+			count[i] = 0;
+			if (s->eof)
+				continue;
+			if (!pump_stage_nlive (s))
+				return;
+			active = true;
+
+			/* Reading from the input is only useful if it isn't
+			 * already backed up in our hands.
+			 */
+			if (!s->pending && !pipeline_peek_size (s->in_p)) {
+				fds[nfds].fd = s->in;
+				fds[nfds].events = POLLIN;
+				++nfds;
+			}
+			for (j = 0; j < 2; ++j) {
+				if (!s->live[j])
+					continue;
+				/* Data pending for out[0] has already
+				 * reached out[1].
+				 */
+				if (j == 1 && s->pending)
+					continue;
+				fds[nfds].fd = s->out[j];
+				fds[nfds].events = POLLOUT;
+				++nfds;
+			}
+			count[i] = nfds - first[i];
+		}
+		if (!active)
+			return;
+
+		if (poll (fds, nfds, -1) < 0) {
+			if (errno == EINTR)
+				continue;
+			return;
+		}
+
+		for (i = 0; i < nstages; ++i) {
+			bool ready = !stages[i].eof;
+
+			for (j = first[i]; ready && j < first[i] + count[i];
+			     ++j)
+				if (!fds[j].revents)
+					ready = false;
+			if (!ready)
+				continue;
+			if (!pump_stage_step (&stages[i], devnull))
+				return;
+		}
+	}
+}
+
+void zerocopy_pump (pipeline *source, pipeline *filter, pipeline *sink,
+                    pipeline *tee)
+{
+	struct pump_stage stages[2];
+	size_t nstages;
+	int devnull;
+	struct sigaction sa, osa;
+
+	/* Splicing into a sink only makes sense if it is a pipe, which
+	 * means that it has to run at least one command.  Peeked data is
+	 * only written to the first sink, so a tee directly from the
+	 * source with peeked data is left to pipeline_pump too.
+	 */
+	if ((filter && !pipeline_get_ncommands (filter)) ||
+	    !pipeline_get_ncommands (sink) ||
+	    (tee && !pipeline_get_ncommands (tee)) ||
+	    (!filter && tee && pipeline_peek_size (source)))
+		goto fallback;
+
+	devnull = open ("/dev/null", O_WRONLY | O_CLOEXEC);
+	if (devnull < 0)
+		goto fallback;
+
+	if (filter)
+		pipeline_start (filter);
+	pipeline_start (sink);
+	if (tee)
+		pipeline_start (tee);
+
+	if (filter) {
+		pump_stage_init (&stages[0], source, filter, NULL);
+		pump_stage_init (&stages[1], filter, sink, tee);
+		nstages = 2;
+	} else {
+		pump_stage_init (&stages[0], source, sink, tee);
+		nstages = 1;
+	}
+
+	/* Like pipeline_pump, treat sinks that exit early as a normal
+	 * condition rather than a fatal signal.
+	 */
+	memset (&sa, 0, sizeof sa);
+	sa.sa_handler = SIG_IGN;
+	sigemptyset (&sa.sa_mask);
+	sigaction (SIGPIPE, &sa, &osa);
+
+	debug ("zero-copy pump: %zu stage(s)\n", nstages);
+	pump_stages (stages, nstages, devnull);
+
+	sigaction (SIGPIPE, &osa, NULL);
+	close (devnull);
+
+fallback:
+	/* Either there is nothing left to do, in which case this just
+	 * closes the sinks' input, or this carries on where we left off.
+	 */
+	pump_rest (source, filter, sink, tee);
+}
+
+#else /* !HAVE_SPLICE || !HAVE_TEE */
+
+void zerocopy_pump (pipeline *source, pipeline *filter, pipeline *sink,
+                    pipeline *tee)
+{
+	pump_rest (source, filter, sink, tee);
+}
+
+#endif /* HAVE_SPLICE && HAVE_TEE */
@@ -0,0 +1,42 @@
+/*
+ * pump.h: interface to zero-copy pumping between pipelines
+ *
+ * Copyright (C) 2024 Colin Watson.
+ *
+ * This file is part of man-db.
+ *
+ * man-db is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * man-db is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with man-db; if not, write to the Free Software Foundation,
+ * Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ */
+
+#ifndef MAN_PUMP_H
+#define MAN_PUMP_H
+
+#include "pipeline.h"
+
+/* Pump data through a chain of pipelines that have already been connected
+ * using pipeline_connect: SOURCE feeds FILTER, and FILTER feeds SINK and
+ * (if non-NULL) TEE.  FILTER may be NULL, in which case SOURCE feeds SINK
+ * and TEE directly.  Any pipelines not yet started are started.
+ *
+ * This is equivalent to calling pipeline_pump on the same pipelines, but
+ * where the kernel supports it the data is moved between pipes using
+ * splice and tee rather than being copied through our own buffers.
+ * Anything the fast path cannot handle is left to pipeline_pump, so the
+ * result is the same either way.
+ */
+void zerocopy_pump (pipeline *source, pipeline *filter, pipeline *sink,
+                    pipeline *tee);
+
+#endif /* MAN_PUMP_H */
@@ -44,7 +44,9 @@
 #include "dirname.h"
 #include "error.h"
 #include "gl_array_list.h"
+#include "gl_hash_set.h"
 #include "gl_xlist.h"
+#include "gl_xset.h"
 #include "xalloc.h"
 
 #include "gettext.h"
@@ -53,12 +55,14 @@
 #include "manconfig.h"
 
 #include "appendstr.h"
+#include "arena.h"
 #include "compression.h"
 #include "debug.h"
 #include "decompress.h"
 #include "encodings.h"
 #include "filenames.h"
 #include "glcontainers.h"
+#include "intern.h"
 #include "orderfiles.h"
 #include "pipeline.h"
 #include "sandbox.h"
@@ -77,12 +81,156 @@
 
 static char *catdir, *mandir;
 
+/* Descriptions parsed from a single stray, released once it is stored. */
+static struct arena *stray_arena = NULL;
+
+/* A cat page with no corresponding manual page. */
+struct stray {
+	char *catfile;
+	char *name;
+	char *lang;
+	struct mandata *info;
+	decompress *decomp;
+};
+
+/* How many strays to have running through col at once. */
+#define STRAY_WINDOW 4
+
+/* Return the set of names in mandir, each with any compression extension
+ * stripped as well as in full, so that the existence of a manual page
+ * can be checked without probing for every possible compressed file.
+ */
+static gl_set_t read_man_names (void)
+{
+	gl_set_t names = new_string_set (GL_HASH_SET);
+	DIR *mdir;
+	struct dirent *manlist;
+
+	mdir = opendir (mandir);
+	if (!mdir) {
+		debug ("can't search directory %s\n", mandir);
+		return names;
+	}
+	while ((manlist = readdir (mdir)) != NULL) {
+		struct compression *comp;
+
+		if (*manlist->d_name == '.' &&
+		    strlen (manlist->d_name) < (size_t) 3)
+			continue;
+		gl_set_add (names, xstrdup (manlist->d_name));
+		comp = comp_info (manlist->d_name, true);
+		if (comp && !gl_set_add (names, comp->stem))
+			free (comp->stem);
+	}
+	closedir (mdir);
+	return names;
+}
+
+static void stray_free (struct stray *stray)
+{
+	if (stray->decomp)
+		decompress_free (stray->decomp);
+	free_mandata_struct (stray->info);
+	free (stray->lang);
+	free (stray->name);
+	free (stray->catfile);
+}
+
+/* Start filtering a stray through col, so that it can run while earlier
+ * strays are being dealt with.
+ */
+static void stray_start (struct stray *stray)
+{
+	char *page_encoding;
+	pipecmd *col_cmd;
+	char *col_locale;
+	char *fullpath;
+
+	drop_effective_privs ();
+	stray->decomp = decompress_open (stray->catfile, 0);
+	regain_effective_privs ();
+	if (!stray->decomp) {
+		error (0, errno, _ ("can't open %s"), stray->catfile);
+		return;
+	}
+
+	page_encoding = get_page_encoding (stray->lang);
+	if (page_encoding)
+		add_manconv (decompress_get_pipeline (stray->decomp),
+		             page_encoding, "UTF-8");
+	free (page_encoding);
+
+	col_cmd = pipecmd_new_argstr (get_def_user ("col", PROG_COL));
+	pipecmd_arg (col_cmd, "-bx");
+	col_locale = find_charset_locale ("UTF-8");
+	if (col_locale) {
+		pipecmd_setenv (col_cmd, "LC_CTYPE", col_locale);
+		free (col_locale);
+	}
+	pipecmd_pre_exec (col_cmd, sandbox_load, sandbox_free, sandbox);
+	pipeline_command (decompress_get_pipeline (stray->decomp), col_cmd);
+
+	fullpath = canonicalize_file_name (stray->catfile);
+	if (!fullpath) {
+		gripe_canonicalize_failed (stray->catfile);
+		decompress_free (stray->decomp);
+		stray->decomp = NULL;
+		return;
+	}
+	free (fullpath);
+
+	drop_effective_privs ();
+	decompress_start (stray->decomp);
+	regain_effective_privs ();
+}
+
+/* Read the whatis information from a stray started by stray_start, and
+ * store it.
+ */
+static int stray_finish (MYDBM_FILE dbf, struct stray *stray)
+{
+	int strays = 1;
+	lexgrog lg;
+	char *catfile_base;
+
+	lg.whatis = 0;
+	lg.type = CATPAGE;
+	catfile_base = base_name (stray->catfile);
+	if (find_name_decompressed (stray->decomp, catfile_base, &lg)) {
+		struct page_description *descs;
+		size_t ndescs;
+		gl_list_t trace;
+
+		strays++;
+		if (!stray_arena)
+			stray_arena = arena_new ();
+		descs = parse_descriptions (stray->name, lg.whatis,
+		                            stray_arena, &ndescs);
+		trace = new_string_list (GL_ARRAY_LIST, true);
+		gl_list_add_last (trace, xstrdup (stray->catfile));
+		store_descriptions (dbf, descs, ndescs, stray->info, NULL,
+		                    stray->name, trace, stray_arena);
+		gl_list_free (trace);
+		arena_reset (stray_arena);
+	} else if (quiet < 2)
+		error (0, 0, _ ("warning: %s: whatis parse for %s(%s) failed"),
+		       stray->catfile, stray->name, stray->info->sec);
+	free (catfile_base);
+	free (lg.whatis);
+
+	return strays;
+}
+
 static int check_for_stray (MYDBM_FILE dbf)
 {
 	DIR *cdir;
 	struct dirent *catlist;
 	gl_list_t names;
+	gl_set_t man_names;
 	const char *name;
+	struct file_order *order;
+	struct stray *strays_found = NULL;
+	size_t nstrays = 0, strays_max = 0, started, i;
 	size_t lenman, lencat;
 	int strays = 0;
 
@@ -102,20 +250,25 @@ static int check_for_stray (MYDBM_FILE dbf)
 	}
 	closedir (cdir);
 
-	order_files (catdir, &names);
+	man_names = read_man_names ();
+
+	order = order_files (catdir, &names);
 
 	mandir = appendstr (mandir, "/", nullptr);
 	catdir = appendstr (catdir, "/", nullptr);
 	lenman = strlen (mandir);
 	lencat = strlen (catdir);
 
+	/* First find the strays, which only needs the directory contents
+	 * and the database.
+	 */
 	GL_LIST_FOREACH (names, name) {
 		struct mandata *info;
 		char *ext, *section = NULL;
-		short found;
-		struct stat buf;
-		struct compression *comp;
+		struct mandata *exists;
+		struct stray *stray;
 
+		order_files_next (order);
 		info = XZALLOC (struct mandata);
 
 		*(mandir + lenman) = *(catdir + lencat) = '\0';
@@ -132,7 +285,7 @@ static int check_for_stray (MYDBM_FILE dbf)
 			goto next;
 		} else if (comp_info (ext, false)) {
 			*ext = '\0';
-			info->comp = xstrdup (ext + 1);
+			info->comp = intern_string (ext + 1);
 		}
 
 		ext = strrchr (mandir, '.');
@@ -159,128 +312,66 @@ static int check_for_stray (MYDBM_FILE dbf)
 
 		debug ("Testing for existence: %s\n", mandir);
 
-		if (stat (mandir, &buf) == 0)
-			found = 1;
-		else if ((comp = comp_file (mandir))) {
-			found = 1;
-			free (comp->stem);
-		} else
-			found = 0;
-
-		if (!found) {
-			decompress *decomp;
-			struct mandata *exists;
-			lexgrog lg;
-			char *lang, *page_encoding;
-			char *mandir_base;
-			pipecmd *col_cmd;
-			char *col_locale;
-			char *fullpath;
-
-			/* we have a straycat. Need to filter it and get
-			   its whatis (if necessary)  */
-
-			lg.whatis = 0;
-			*(ext++) = '\0';
-			info->ext = xstrdup (ext);
-
-			/* see if we already have it, before going any
-			   further */
-			mandir_base = base_name (mandir);
-			exists = dblookup_exact (dbf, mandir_base, info->ext,
-			                         true);
-			if (exists &&
-			    compare_ids (STRAY_CAT, exists->id, false) >= 0)
-				goto next_exists;
-			debug ("%s(%s) is not in the db.\n", mandir_base,
-			       info->ext);
-
-			/* fill in the missing parts of the structure */
-			info->sec = xstrdup (section);
-			info->id = STRAY_CAT;
-			info->filter = xstrdup ("-");
-			info->mtime.tv_sec = 0;
-			info->mtime.tv_nsec = 0;
-
-			drop_effective_privs ();
-			decomp = decompress_open (catdir, 0);
-			regain_effective_privs ();
-			if (!decomp) {
-				error (0, errno, _ ("can't open %s"), catdir);
-				goto next_exists;
-			}
-
-			lang = lang_dir (mandir);
-			page_encoding = get_page_encoding (lang);
-			if (page_encoding)
-				add_manconv (decompress_get_pipeline (decomp),
-				             page_encoding, "UTF-8");
-			free (page_encoding);
-			free (lang);
-
-			col_cmd = pipecmd_new_argstr (
-			        get_def_user ("col", PROG_COL));
-			pipecmd_arg (col_cmd, "-bx");
-			col_locale = find_charset_locale ("UTF-8");
-			if (col_locale) {
-				pipecmd_setenv (col_cmd, "LC_CTYPE",
-				                col_locale);
-				free (col_locale);
-			}
-			pipecmd_pre_exec (col_cmd, sandbox_load, sandbox_free,
-			                  sandbox);
-			pipeline_command (decompress_get_pipeline (decomp),
-			                  col_cmd);
-
-			fullpath = canonicalize_file_name (catdir);
-			if (!fullpath)
-				gripe_canonicalize_failed (catdir);
-			else {
-				char *catdir_base;
-
-				free (fullpath);
-				drop_effective_privs ();
-				decompress_start (decomp);
-				regain_effective_privs ();
-
-				strays++;
-
-				lg.type = CATPAGE;
-				catdir_base = base_name (catdir);
-				if (find_name_decompressed (
-				            decomp, catdir_base, &lg)) {
-					gl_list_t descs, trace;
-					strays++;
-					descs = parse_descriptions (
-					        mandir_base, lg.whatis);
-					trace = new_string_list (GL_ARRAY_LIST,
-					                         true);
-					gl_list_add_last (trace,
-					                  xstrdup (catdir));
-					store_descriptions (dbf, descs, info,
-					                    NULL, mandir_base,
-					                    trace);
-					gl_list_free (trace);
-					gl_list_free (descs);
-				} else if (quiet < 2)
-					error (0, 0,
-					       _ ("warning: %s: whatis parse "
-					          "for %s(%s) failed"),
-					       catdir, mandir_base, info->sec);
-				free (catdir_base);
-			}
-
-			free (lg.whatis);
-			decompress_free (decomp);
-next_exists:
+		if (gl_set_search (man_names, mandir + lenman))
+			goto next;
+
+		/* we have a straycat. Need to filter it and get its whatis
+		   (if necessary) */
+
+		*(ext++) = '\0';
+		info->ext = intern_string (ext);
+
+		/* see if we already have it, before going any further */
+		exists = dblookup_exact (dbf, mandir + lenman, info->ext,
+		                         true);
+		if (exists && compare_ids (STRAY_CAT, exists->id, false) >= 0) {
 			free_mandata_struct (exists);
-			free (mandir_base);
+			goto next;
 		}
+		free_mandata_struct (exists);
+		debug ("%s(%s) is not in the db.\n", mandir + lenman,
+		       info->ext);
+
+		/* fill in the missing parts of the structure */
+		info->sec = intern_string (section);
+		info->id = STRAY_CAT;
+		info->filter = intern_string ("-");
+		info->mtime.tv_sec = 0;
+		info->mtime.tv_nsec = 0;
+
+		if (nstrays == strays_max)
+			strays_found = x2nrealloc (strays_found, &strays_max,
+			                           sizeof *strays_found);
+		stray = &strays_found[nstrays++];
+		stray->catfile = xstrdup (catdir);
+		stray->name = xstrdup (mandir + lenman);
+		stray->lang = lang_dir (mandir);
+		stray->info = info;
+		stray->decomp = NULL;
+		info = NULL;
+
 next:
 		free (section);
 		free_mandata_struct (info);
 	}
+	order_files_free (order);
 	gl_list_free (names);
+	gl_set_free (man_names);
+
+	/* Now get the whatis information from each stray.  Keep a few col
+	 * processes running ahead of the one being read from, so that
+	 * they can get on with it in parallel.
+	 */
+	started = 0;
+	for (i = 0; i < nstrays; ++i) {
+		while (started < nstrays && started < i + STRAY_WINDOW)
+			stray_start (&strays_found[started++]);
+		if (strays_found[i].decomp)
+			strays += stray_finish (dbf, &strays_found[i]);
+		stray_free (&strays_found[i]);
+	}
+	free (strays_found);
+
 	return strays;
 }
 
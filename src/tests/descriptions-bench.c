@@ -0,0 +1,362 @@
+/*
+ * descriptions-bench.c: check and time whatis description parsing
+ *
+ * Copyright (C) 2024 Colin Watson.
+ *
+ * This file is part of man-db.
+ *
+ * man-db is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * man-db is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with man-db; if not, write to the Free Software Foundation,
+ * Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ */
+
+/* Reads the output of "lexgrog -w" on standard input, rebuilds the whatis
+ * line that lexgrog found for each page, and then checks and times
+ * parse_descriptions against a straightforward reference parser.
+ */
+
+#ifdef HAVE_CONFIG_H
+#  include "config.h"
+#endif /* HAVE_CONFIG_H */
+
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "argp.h"
+#include "progname.h"
+#include "xalloc.h"
+#include "xstrndup.h"
+
+#include "manconfig.h"
+
+#include "arena.h"
+#include "fatal.h"
+
+#include "descriptions.h"
+
+static int iterations = 100;
+
+static struct argp_option options[] = {
+	{"iterations", 'n', "N", 0, "number of times to parse each page", 0},
+	{0}
+};
+
+static error_t parse_opt (int key, char *arg, struct argp_state *state)
+{
+	switch (key) {
+		case 'n':
+			iterations = atoi (arg);
+			if (iterations < 1)
+				argp_error (state, "invalid iteration count");
+			return 0;
+	}
+	return ARGP_ERR_UNKNOWN;
+}
+
+static struct argp argp = {options, parse_opt};
+
+struct page {
+	char *file;
+	char *whatis;
+	size_t len;
+};
+
+static struct page *pages;
+static size_t npages, max_pages;
+static size_t total_names;
+
+static void append (char **str, const char *text, size_t len)
+{
+	size_t old = *str ? strlen (*str) : 0;
+
+	*str = xrealloc (*str, old + len + 1);
+	memcpy (*str + old, text, len);
+	(*str)[old + len] = '\0';
+}
+
+/* The record being rebuilt: its names so far, and its description
+ * including the leading " - ".
+ */
+static char *record_names, *record_desc;
+
+static void flush_record (void)
+{
+	struct page *page = &pages[npages - 1];
+
+	if (!record_names)
+		return;
+	if (page->whatis)
+		append (&page->whatis, "\x11", 1);
+	append (&page->whatis, record_names, strlen (record_names));
+	append (&page->whatis, record_desc, strlen (record_desc));
+	free (record_names);
+	free (record_desc);
+	record_names = record_desc = NULL;
+}
+
+/* Rebuild each page's whatis line from lexgrog's output, which has one line
+ * per name.  Consecutive names with the same description are put back
+ * into a single record, as they would have been on the page.
+ */
+static void read_pages (FILE *input)
+{
+	char *line = NULL;
+	size_t line_max = 0;
+
+	while (getline (&line, &line_max, input) >= 0) {
+		char *quote = strstr (line, ": \"");
+		char *end, *dash;
+
+		if (!quote)
+			continue;
+		*quote = '\0';
+		quote += 3;
+		end = strrchr (quote, '"');
+		if (!end)
+			continue;
+		*end = '\0';
+		dash = strstr (quote, " - ");
+		if (!dash)
+			continue;
+		++total_names;
+
+		if (!npages || !STREQ (pages[npages - 1].file, line)) {
+			if (npages)
+				flush_record ();
+			if (npages == max_pages)
+				pages = x2nrealloc (pages, &max_pages,
+				                    sizeof *pages);
+			pages[npages].file = xstrdup (line);
+			pages[npages].whatis = NULL;
+			++npages;
+		} else if (record_desc && STREQ (record_desc, dash)) {
+			append (&record_names, ", ", 2);
+			append (&record_names, quote, dash - quote);
+			continue;
+		} else
+			flush_record ();
+
+		record_names = xstrndup (quote, dash - quote);
+		record_desc = xstrdup (dash);
+	}
+	if (npages)
+		flush_record ();
+
+	free (line);
+}
+
+/* Copy the LEN bytes at S without leading and trailing spaces. */
+static char *reference_trim (const char *s, size_t len)
+{
+	while (len && *s == ' ') {
+		++s;
+		--len;
+	}
+	while (len && s[len - 1] == ' ')
+		--len;
+	return xstrndup (s, len);
+}
+
+/* A deliberately simple parser that copies every record and name, against
+ * which to check the real one.
+ */
+static size_t reference_parse (const char *whatis, char ***names,
+                               char ***descs)
+{
+	size_t n = 0, max = 0;
+	const char *sep = whatis;
+
+	*names = NULL;
+	*descs = NULL;
+	while (sep) {
+		const char *nextsep, *dash, *token;
+		size_t length;
+
+		while (*sep == 0x11 || *sep == ' ')
+			++sep;
+		nextsep = strchr (sep, 0x11);
+		length = nextsep ? (size_t) (nextsep - sep) : strlen (sep);
+		if (!length)
+			break;
+
+		dash = memmem (sep, length, " - ", 3);
+		if (!dash && n)
+			goto next;
+		for (token = sep; token < (dash ? dash : sep + length);) {
+			const char *limit = dash ? dash : sep + length;
+			const char *comma = memchr (token, ',', limit - token);
+			const char *token_end = comma ? comma : limit;
+			char *name;
+
+			if (token_end == token) {
+				token = token_end + 1;
+				continue;
+			}
+			name = reference_trim (token, token_end - token);
+			token = token_end + 1;
+			if (strpbrk (name, " \t")) {
+				free (name);
+				continue;
+			}
+			if (n == max) {
+				*names = x2nrealloc (*names, &max,
+				                     sizeof **names);
+				*descs = xnrealloc (*descs, max,
+				                    sizeof **descs);
+			}
+			(*names)[n] = name;
+			(*descs)[n] = dash
+			        ? reference_trim (dash + 3,
+			                          sep + length - (dash + 3))
+			        : NULL;
+			++n;
+		}
+next:
+		sep = nextsep;
+	}
+
+	return n;
+}
+
+static void reference_free (size_t n, char **names, char **descs)
+{
+	size_t i;
+
+	for (i = 0; i < n; ++i) {
+		free (names[i]);
+		free (descs[i]);
+	}
+	free (names);
+	free (descs);
+}
+
+static bool strings_differ (const char *a, const char *b)
+{
+	if (!a || !b)
+		return a != b;
+	return !STREQ (a, b);
+}
+
+static int check_pages (struct arena *arena, char *scratch)
+{
+	int failures = 0;
+	size_t i, j;
+
+	for (i = 0; i < npages; ++i) {
+		char **names, **descs;
+		size_t n, count;
+		struct page_description *parsed;
+
+		n = reference_parse (pages[i].whatis, &names, &descs);
+		memcpy (scratch, pages[i].whatis, pages[i].len + 1);
+		parsed = parse_descriptions (NULL, scratch, arena, &count);
+		if (count != n) {
+			fprintf (stderr, "%s: expected %zu names, got %zu\n",
+			         pages[i].file, n, count);
+			++failures;
+		} else {
+			for (j = 0; j < n; ++j) {
+				if (strings_differ (names[j],
+				                    parsed[j].name) ||
+				    strings_differ (descs[j],
+				                    parsed[j].whatis)) {
+					fprintf (stderr,
+					         "%s: mismatch at name %zu\n",
+					         pages[i].file, j);
+					++failures;
+					break;
+				}
+			}
+		}
+		reference_free (n, names, descs);
+		arena_reset (arena);
+	}
+
+	return failures;
+}
+
+static void report (const char *name, clock_t elapsed)
+{
+	double seconds = (double) elapsed / CLOCKS_PER_SEC;
+
+	if (seconds > 0)
+		printf ("%s: %.0f pages/s\n", name,
+		        (double) npages * iterations / seconds);
+	else
+		printf ("%s: too fast to measure\n", name);
+}
+
+int main (int argc, char **argv)
+{
+	struct arena *arena;
+	char *scratch;
+	size_t max_len = 0, i;
+	clock_t start;
+	int failures, iter;
+
+	set_program_name (argv[0]);
+
+	if (argp_parse (&argp, argc, argv, 0, 0, 0))
+		exit (FAIL);
+
+	read_pages (stdin);
+	if (!npages)
+		fatal (0, "no lexgrog output on standard input");
+	for (i = 0; i < npages; ++i) {
+		pages[i].len = strlen (pages[i].whatis);
+		if (pages[i].len > max_len)
+			max_len = pages[i].len;
+	}
+	printf ("%zu pages, %zu names\n", npages, total_names);
+
+	arena = arena_new ();
+	scratch = xmalloc (max_len + 1);
+
+	failures = check_pages (arena, scratch);
+
+	start = clock ();
+	for (iter = 0; iter < iterations; ++iter) {
+		for (i = 0; i < npages; ++i) {
+			char **names, **descs;
+			size_t n = reference_parse (pages[i].whatis, &names,
+			                            &descs);
+			reference_free (n, names, descs);
+		}
+	}
+	report ("reference", clock () - start);
+
+	/* Copying each line into the scratch buffer is part of the cost,
+	 * since parse_descriptions works in place.
+	 */
+	start = clock ();
+	for (iter = 0; iter < iterations; ++iter) {
+		for (i = 0; i < npages; ++i) {
+			size_t count;
+
+			memcpy (scratch, pages[i].whatis, pages[i].len + 1);
+			parse_descriptions (NULL, scratch, arena, &count);
+			arena_reset (arena);
+		}
+	}
+	report ("parse_descriptions", clock () - start);
+
+	free (scratch);
+	arena_free (arena);
+
+	if (failures)
+		fatal (0, "%d parsing mismatches", failures);
+	exit (OK);
+}
@@ -105,6 +105,18 @@ expect_files_equal () {
 	report "$1" "$ret"
 }
 
+# Arguments: description command [args...]
+# Run a benchmark program, which checks its own results, and show what it
+# says about its timings in the test log.
+run_bench () {
+	desc="$1"
+	shift
+	ret=0
+	"$@" >"$tmpdir/bench.out" 2>"$tmpdir/bench.err" || ret=$?
+	cat "$tmpdir/bench.out" "$tmpdir/bench.err"
+	report "$desc" "$ret"
+}
+
 report_skip () {
 	echo "  SKIP: $1"
 }
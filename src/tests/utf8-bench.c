@@ -0,0 +1,221 @@
+/*
+ * utf8-bench.c: check and time UTF-8 validation
+ *
+ * Copyright (C) 2024 Colin Watson.
+ *
+ * This file is part of man-db.
+ *
+ * man-db is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * man-db is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with man-db; if not, write to the Free Software Foundation,
+ * Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ */
+
+#ifdef HAVE_CONFIG_H
+#  include "config.h"
+#endif /* HAVE_CONFIG_H */
+
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "argp.h"
+#include "progname.h"
+#include "xalloc.h"
+
+#include "manconfig.h"
+
+#include "fatal.h"
+
+#include "utf8.h"
+
+static int iterations = 100;
+
+static struct argp_option options[] = {
+	{"iterations", 'n', "N", 0, "number of times to validate each sample",
+	 0},
+	{0}
+};
+
+static error_t parse_opt (int key, char *arg, struct argp_state *state)
+{
+	switch (key) {
+		case 'n':
+			iterations = atoi (arg);
+			if (iterations < 1)
+				argp_error (state, "invalid iteration count");
+			return 0;
+	}
+	return ARGP_ERR_UNKNOWN;
+}
+
+static struct argp argp = {options, parse_opt};
+
+/* A deliberately simple validator, following the table in RFC 3629
+ * Section 4 one byte at a time, against which to check the real one.
+ */
+static size_t reference_prefix (const char *str, size_t len)
+{
+	const unsigned char *s = (const unsigned char *) str;
+	size_t i = 0;
+
+	while (i < len && s[i]) {
+		unsigned char lo = 0x80, hi = 0xBF;
+		size_t need, j;
+
+		if (s[i] < 0x80) {
+			++i;
+			continue;
+		} else if (s[i] >= 0xC2 && s[i] <= 0xDF)
+			need = 1;
+		else if (s[i] >= 0xE0 && s[i] <= 0xEF) {
+			need = 2;
+			if (s[i] == 0xE0)
+				lo = 0xA0;
+			else if (s[i] == 0xED)
+				hi = 0x9F;
+		} else if (s[i] >= 0xF0 && s[i] <= 0xF4) {
+			need = 3;
+			if (s[i] == 0xF0)
+				lo = 0x90;
+			else if (s[i] == 0xF4)
+				hi = 0x8F;
+		} else
+			break;
+
+		if (i + need >= len)
+			break;
+		if (s[i + 1] < lo || s[i + 1] > hi)
+			break;
+		for (j = 2; j <= need; ++j)
+			if ((s[i + j] & 0xC0) != 0x80)
+				break;
+		if (j <= need)
+			break;
+		i += need + 1;
+	}
+
+	return i;
+}
+
+static int failures;
+
+static void check (const char *what, const char *str, size_t len)
+{
+	size_t expected = reference_prefix (str, len);
+	size_t got = utf8_valid_prefix (str, len);
+
+	if (got != expected) {
+		fprintf (stderr,
+		         "%s: expected %zu valid bytes of %zu, got %zu\n",
+		         what, expected, len, got);
+		++failures;
+	}
+}
+
+/* Fill BUF with LEN bytes of text built from UNIT, cutting off the last
+ * copy so that exactly LEN bytes are used.
+ */
+static void fill (char *buf, size_t len, const char *unit)
+{
+	size_t unit_len = strlen (unit), i;
+
+	for (i = 0; i < len; ++i)
+		buf[i] = unit[i % unit_len];
+}
+
+static const char *const interesting[] = {
+	"\xC3\xA9",		/* é */
+	"\xE2\x80\x94",		/* em dash */
+	"\xF0\x9F\x98\x80",	/* emoji */
+	"\xC0\xAF",		/* overlong */
+	"\xED\xA0\x80",		/* surrogate */
+	"\xF4\x90\x80\x80",	/* beyond U+10FFFF */
+	"\x80",			/* stray continuation byte */
+	"\xE2\x80",		/* truncated */
+	"\xFF",
+	"",			/* NUL */
+};
+
+/* Drop each interesting sequence into an ASCII buffer at every offset, so
+ * that it lands at every position relative to the blocks that the fast
+ * paths check at once.
+ */
+static void check_positions (void)
+{
+	char buf[160];
+	size_t i, pos;
+
+	for (i = 0; i < sizeof interesting / sizeof *interesting; ++i) {
+		size_t ilen = strlen (interesting[i]);
+
+		if (!ilen)
+			ilen = 1;
+		for (pos = 0; pos + ilen <= sizeof buf; ++pos) {
+			size_t len;
+
+			fill (buf, sizeof buf, "The quick brown fox. ");
+			memcpy (buf + pos, interesting[i], ilen);
+			for (len = pos; len <= sizeof buf; len += 7)
+				check ("position", buf, len);
+			check ("position", buf, sizeof buf);
+		}
+	}
+}
+
+static void bench (const char *name, const char *unit)
+{
+	const size_t len = 1024 * 1024;
+	char *buf = xmalloc (len);
+	size_t valid = 0;
+	clock_t start, elapsed;
+	double seconds;
+	int i;
+
+	fill (buf, len, unit);
+	check (name, buf, len);
+
+	start = clock ();
+	for (i = 0; i < iterations; ++i)
+		valid += utf8_valid_prefix (buf, len);
+	elapsed = clock () - start;
+
+	seconds = (double) elapsed / CLOCKS_PER_SEC;
+	if (seconds > 0)
+		printf ("%s: %.0f MB/s\n", name,
+		        (double) valid / seconds / (1024 * 1024));
+	else
+		printf ("%s: too fast to measure\n", name);
+
+	free (buf);
+}
+
+int main (int argc, char **argv)
+{
+	set_program_name (argv[0]);
+
+	if (argp_parse (&argp, argc, argv, 0, 0, 0))
+		exit (FAIL);
+
+	check_positions ();
+
+	bench ("ascii", ".TH TEST 1\n.SH NAME\ntest \\- a test page\n");
+	bench ("latin", "Fran\xC3\xA7" "ais, na\xC3\xAFve caf\xC3\xA9. ");
+	bench ("cjk", "\xE6\x97\xA5\xE6\x9C\xAC\xE8\xAA\x9E\xE3\x81\xAE"
+	              "\xE3\x83\x9A\xE3\x83\xBC\xE3\x82\xB8\n");
+
+	if (failures)
+		fatal (0, "%d validation mismatches", failures);
+	exit (OK);
+}
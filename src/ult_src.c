@@ -78,52 +78,111 @@ void gripe_canonicalize_failed (const char *path)
 	}
 }
 
+/* For each directory we know about, a map from inode number to the
+ * lexicographically smallest name in that directory with that inode.
+ */
+struct ult_dir {
+	gl_map_t inodes;
+};
+
+static gl_map_t ult_dirs = NULL;
+
+static bool ATTRIBUTE_PURE inode_equals (const void *key1, const void *key2)
+{
+	return *(const ino_t *) key1 == *(const ino_t *) key2;
+}
+
+static size_t ATTRIBUTE_PURE inode_hash (const void *key)
+{
+	return (size_t) *(const ino_t *) key;
+}
+
+static void ult_dir_free (const void *value)
+{
+	struct ult_dir *udir = (struct ult_dir *) value;
+
+	gl_map_free (udir->inodes);
+	free (udir);
+}
+
+struct ult_dir *ult_dir_new (const char *dir)
+{
+	struct ult_dir *udir = XMALLOC (struct ult_dir);
+
+	if (!ult_dirs)
+		ult_dirs = new_string_map (GL_HASH_MAP, ult_dir_free);
+	udir->inodes = gl_map_create_empty (GL_HASH_MAP, inode_equals,
+	                                    inode_hash, plain_free, plain_free);
+	gl_map_remove (ult_dirs, dir);
+	gl_map_put (ult_dirs, xstrdup (dir), udir);
+	return udir;
+}
+
+void ult_dir_add (struct ult_dir *udir, const char *name, ino_t inode)
+{
+	const char *existing;
+	ino_t *key;
+
+	if (gl_map_search (udir->inodes, &inode, (const void **) &existing)) {
+		if (strcmp (name, existing) >= 0)
+			return;
+		/* gl_map_put would leak the new key. */
+		gl_map_remove (udir->inodes, &inode);
+	}
+	key = XMALLOC (ino_t);
+	*key = inode;
+	gl_map_put (udir->inodes, key, xstrdup (name));
+}
+
 /* Find minimum value hard link filename for given file and inode.
  * Returns a newly allocated string.
  */
 static char *ult_hardlink (const char *fullpath, ino_t inode)
 {
-	DIR *mdir;
-	struct dirent *manlist;
-	char *base, *dir, *ret;
+	struct ult_dir *udir;
+	const char *least;
+	char *dir, *ret;
 	const char *slash;
 
 	slash = strrchr (fullpath, '/');
 	assert (slash);
 	dir = xstrndup (fullpath, slash - fullpath);
-	base = xstrdup (++slash);
+	++slash;
 
-	mdir = opendir (dir);
-	if (mdir == NULL) {
-		if (quiet < 2)
-			error (0, errno, _ ("can't search directory %s"), dir);
-		free (dir);
-		free (base);
-		return NULL;
-	}
+	udir = ult_dirs ? (struct ult_dir *) gl_map_get (ult_dirs, dir)
+	                : NULL;
+	if (!udir) {
+		/* Nobody has told us about this directory, so read it. */
+		DIR *mdir;
+		struct dirent *manlist;
 
-	while ((manlist = readdir (mdir))) {
-		if (manlist->d_ino == inode &&
-		    strcmp (base, manlist->d_name) > 0) {
-			free (base);
-			base = xstrdup (manlist->d_name);
-			debug ("ult_hardlink: (%s)\n", base);
+		mdir = opendir (dir);
+		if (mdir == NULL) {
+			if (quiet < 2)
+				error (0, errno,
+				       _ ("can't search directory %s"), dir);
+			free (dir);
+			return NULL;
 		}
+		udir = ult_dir_new (dir);
+		while ((manlist = readdir (mdir)))
+			ult_dir_add (udir, manlist->d_name, manlist->d_ino);
+		closedir (mdir);
 	}
-	closedir (mdir);
+
+	least = (const char *) gl_map_get (udir->inodes, &inode);
 
 	/* If we already are the link with the smallest name value */
 	/* return NULL */
 
-	if (strcmp (base, slash) == 0) {
+	if (!least || strcmp (least, slash) >= 0) {
 		free (dir);
-		free (base);
 		return NULL;
 	}
 
-	ret = xasprintf ("%s/%s", dir, base);
+	debug ("ult_hardlink: (%s)\n", least);
+	ret = xasprintf ("%s/%s", dir, least);
 	free (dir);
-	free (base);
 	return ret;
 }
 
@@ -449,3 +508,29 @@ err:
 	free (base);
 	return NULL;
 }
+
+const struct ult_value *ult_src_add (const char *name, int flags,
+                                     gl_list_t trace)
+{
+	struct ult_key *key;
+	const struct ult_value *existing;
+	struct ult_value *value;
+
+	if (!ult_cache)
+		ult_cache = gl_map_create_empty (GL_HASH_MAP, ult_key_equals,
+		                                 ult_key_hash, ult_key_free,
+		                                 ult_value_free);
+	key = ult_key_new (name, flags);
+	if (gl_map_search (ult_cache, key, (const void **) &existing)) {
+		ult_key_free (key);
+		gl_list_free (trace);
+		return existing;
+	}
+
+	value = XMALLOC (struct ult_value);
+	value->path = xstrdup (gl_list_get_at (trace,
+	                                       gl_list_size (trace) - 1));
+	value->trace = trace;
+	gl_map_put (ult_cache, key, value);
+	return value;
+}
@@ -22,6 +22,8 @@
  * Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
  */
 
+#include <sys/types.h>
+
 #include "gl_list.h"
 
 #define SO_LINK   0001
@@ -40,6 +42,25 @@ struct ult_value {
 	gl_list_t trace;
 };
 
+/* The names of the files in a directory, indexed by inode number. */
+struct ult_dir;
+
 extern void gripe_canonicalize_failed (const char *path);
+
+/* Start recording the names of the files in directory DIR, replacing
+ * anything previously recorded for it.  Callers that are reading a
+ * directory anyway can use this to save ult_src from reading it again to
+ * resolve hard links.
+ */
+extern struct ult_dir *ult_dir_new (const char *dir);
+extern void ult_dir_add (struct ult_dir *udir, const char *name,
+                         ino_t inode);
 extern const struct ult_value *ult_src (const char *name, const char *path,
                                         struct stat *buf, int flags);
+
+/* Record that ult_src (NAME, ..., FLAGS) would return a value with the
+ * non-empty TRACE, whose last element is the ultimate source, so that
+ * later calls don't need to do the work.  Takes ownership of TRACE.
+ */
+extern const struct ult_value *ult_src_add (const char *name, int flags,
+                                            gl_list_t trace);
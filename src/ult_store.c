@@ -0,0 +1,249 @@
+/*
+ * ult_store.c: record link resolutions in the database
+ *
+ * Copyright (C) 2024 Colin Watson.
+ *
+ * This file is part of man-db.
+ *
+ * man-db is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * man-db is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with man-db; if not, write to the Free Software Foundation,
+ * Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ * Each record is stored under ULT_STORE_PREFIX followed by the name of
+ * the file that was resolved, and consists of tab-separated fields: the
+ * ult_src flags, the number of entries in the trace, and then for each
+ * entry its path, device, inode, and modification time, and the
+ * modification time of the directory containing it.  The record is valid
+ * as long as all of those are unchanged; directory modification times
+ * catch new hard links and alternative compressed versions of .so
+ * targets.
+ */
+
+#ifdef HAVE_CONFIG_H
+#  include "config.h"
+#endif /* HAVE_CONFIG_H */
+
+#include <inttypes.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <sys/types.h>
+
+#include "dirname.h"
+#include "gl_array_list.h"
+#include "gl_xlist.h"
+#include "stat-time.h"
+#include "xalloc.h"
+#include "xvasprintf.h"
+
+#include "manconfig.h"
+
+#include "appendstr.h"
+#include "debug.h"
+#include "glcontainers.h"
+
+#include "mydbm.h"
+
+#include "ult_src.h"
+#include "ult_store.h"
+
+/* The identity of one file in a trace. */
+struct ult_node {
+	uintmax_t dev, ino;
+	intmax_t mtime_sec, mtime_nsec;
+	intmax_t dir_sec, dir_nsec;
+};
+
+static bool get_node (const char *path, struct ult_node *node)
+{
+	struct stat st;
+	char *dir;
+	int ret;
+
+	if (lstat (path, &st) < 0)
+		return false;
+	node->dev = st.st_dev;
+	node->ino = st.st_ino;
+	node->mtime_sec = get_stat_mtime (&st).tv_sec;
+	node->mtime_nsec = get_stat_mtime (&st).tv_nsec;
+
+	dir = dir_name (path);
+	ret = stat (dir, &st);
+	free (dir);
+	if (ret < 0)
+		return false;
+	node->dir_sec = get_stat_mtime (&st).tv_sec;
+	node->dir_nsec = get_stat_mtime (&st).tv_nsec;
+	return true;
+}
+
+static datum make_key (const char *name)
+{
+	datum key;
+
+	memset (&key, 0, sizeof key);
+	MYDBM_SET (key, xasprintf ("%s%s", ULT_STORE_PREFIX, name));
+	return key;
+}
+
+/* Split off the next tab-separated field of *P, or return NULL if there
+ * isn't one.
+ */
+static char *next_field (char **p)
+{
+	char *field = *p, *tab;
+
+	if (!field)
+		return NULL;
+	tab = strchr (field, '\t');
+	if (tab) {
+		*tab = '\0';
+		*p = tab + 1;
+	} else
+		*p = NULL;
+	return field;
+}
+
+static bool parse_number (char **p, intmax_t *value)
+{
+	char *field = next_field (p), *end;
+
+	if (!field || !*field)
+		return false;
+	*value = strtoimax (field, &end, 10);
+	return !*end;
+}
+
+static bool parse_unsigned (char **p, uintmax_t *value)
+{
+	char *field = next_field (p), *end;
+
+	if (!field || !*field)
+		return false;
+	*value = strtoumax (field, &end, 10);
+	return !*end;
+}
+
+const struct ult_value *ult_store_lookup (MYDBM_FILE dbf, const char *name,
+                                          int flags)
+{
+	datum key, content;
+	char *p;
+	intmax_t stored_flags, count, i;
+	gl_list_t trace = NULL;
+	const struct ult_value *ult = NULL;
+
+	if (*name != '/')
+		return NULL;
+
+	key = make_key (name);
+	content = MYDBM_FETCH (dbf, key);
+	MYDBM_FREE_DPTR (key);
+	if (!MYDBM_DPTR (content))
+		return NULL;
+
+	p = MYDBM_DPTR (content);
+	if (!parse_number (&p, &stored_flags) || stored_flags != flags ||
+	    !parse_number (&p, &count) || count < 1)
+		goto out;
+
+	trace = new_string_list (GL_ARRAY_LIST, true);
+	for (i = 0; i < count; ++i) {
+		char *path = next_field (&p);
+		struct ult_node node;
+		uintmax_t dev, ino;
+		intmax_t mtime_sec, mtime_nsec, dir_sec, dir_nsec;
+
+		if (!path || !parse_unsigned (&p, &dev) ||
+		    !parse_unsigned (&p, &ino) ||
+		    !parse_number (&p, &mtime_sec) ||
+		    !parse_number (&p, &mtime_nsec) ||
+		    !parse_number (&p, &dir_sec) ||
+		    !parse_number (&p, &dir_nsec))
+			goto out;
+		if (!get_node (path, &node) || node.dev != dev ||
+		    node.ino != ino ||
+		    node.mtime_sec != mtime_sec ||
+		    node.mtime_nsec != mtime_nsec || node.dir_sec != dir_sec ||
+		    node.dir_nsec != dir_nsec) {
+			debug ("ult_store: %s has changed since %s was "
+			       "resolved\n",
+			       path, name);
+			goto out;
+		}
+		gl_list_add_last (trace, xstrdup (path));
+	}
+
+	debug ("ult_store: using stored resolution of %s\n", name);
+	ult = ult_src_add (name, flags, trace);
+	trace = NULL;
+
+out:
+	if (trace)
+		gl_list_free (trace);
+	MYDBM_FREE_DPTR (content);
+	return ult;
+}
+
+void ult_store_save (MYDBM_FILE dbf, const char *name, int flags,
+                     const struct ult_value *ult)
+{
+	gl_list_t trace = ult->trace;
+	datum key, content;
+	char *record;
+	size_t i;
+
+	/* Relative names would depend on the current directory. */
+	if (*name != '/')
+		return;
+
+	record = xasprintf ("%d\t%zu", flags, gl_list_size (trace));
+	for (i = 0; i < gl_list_size (trace); ++i) {
+		const char *path = gl_list_get_at (trace, i);
+		struct ult_node node;
+		char *entry;
+
+		/* A tab in a file name would confuse the parser. */
+		if (*path != '/' || strchr (path, '\t') ||
+		    !get_node (path, &node)) {
+			free (record);
+			return;
+		}
+		entry = xasprintf ("\t%s\t%ju\t%ju\t%jd\t%jd\t%jd\t%jd", path,
+		                   node.dev, node.ino, node.mtime_sec,
+		                   node.mtime_nsec, node.dir_sec,
+		                   node.dir_nsec);
+		record = appendstr (record, entry, nullptr);
+		free (entry);
+	}
+
+	key = make_key (name);
+	memset (&content, 0, sizeof content);
+	MYDBM_SET (content, record);
+	MYDBM_REPLACE (dbf, key, content);
+	MYDBM_FREE_DPTR (key);
+	MYDBM_FREE_DPTR (content);
+}
+
+bool ult_store_orphaned (const char *key)
+{
+	struct stat st;
+
+	if (!STRNEQ (key, ULT_STORE_PREFIX, strlen (ULT_STORE_PREFIX)) ||
+	    key[strlen (ULT_STORE_PREFIX)] != '/')
+		return false;
+	return lstat (key + strlen (ULT_STORE_PREFIX), &st) < 0;
+}
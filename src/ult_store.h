@@ -0,0 +1,57 @@
+/*
+ * ult_store.h: interface to stored link resolutions
+ *
+ * Copyright (C) 2024 Colin Watson.
+ *
+ * This file is part of man-db.
+ *
+ * man-db is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * man-db is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with man-db; if not, write to the Free Software Foundation,
+ * Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ */
+
+
+#ifndef MAN_ULT_STORE_H
+#define MAN_ULT_STORE_H
+
+#include <stdbool.h>
+
+#include "mydbm.h"
+
+struct ult_value;
+
+/* mandb records the result of ult_src for each page it indexes in the
+ * database, along with enough information about the files and
+ * directories involved to tell whether it still holds.  These are stored
+ * under keys starting with ULT_STORE_PREFIX, which other database readers
+ * ignore along with other keys starting with '$'.
+ */
+#define ULT_STORE_PREFIX "$ult$"
+
+/* Return the recorded result of ult_src (NAME, ..., FLAGS) if there is
+ * one and nothing it depends on has changed, otherwise NULL.  The result
+ * is shared with ult_src's own cache.
+ */
+extern const struct ult_value *ult_store_lookup (MYDBM_FILE dbf,
+                                                 const char *name, int flags);
+
+/* Record ULT, the result of ult_src (NAME, ..., FLAGS). */
+extern void ult_store_save (MYDBM_FILE dbf, const char *name, int flags,
+                            const struct ult_value *ult);
+
+/* Return true if KEY is a stored link resolution for a file that no
+ * longer exists.
+ */
+extern bool ult_store_orphaned (const char *key);
+
+#endif /* MAN_ULT_STORE_H */
@@ -57,8 +57,10 @@
 #include "dirname.h"
 #include "error.h"
 #include "fnmatch.h"
+#include "gl_hash_map.h"
 #include "gl_hash_set.h"
 #include "gl_list.h"
+#include "gl_xmap.h"
 #include "gl_xset.h"
 #include "progname.h"
 #include "xalloc.h"
@@ -81,6 +83,7 @@
 #include "wordfnmatch.h"
 #include "xregcomp.h"
 
+#include "db_snapshot.h"
 #include "db_storage.h"
 #include "mydbm.h"
 
@@ -115,10 +118,19 @@ static char *multiple_locale = NULL, *internal_locale;
 
 static gl_set_t display_seen = NULL;
 
+/* Pointer targets already resolved in the database being searched, keyed
+ * by "name\text".  A null value records a failed resolution.
+ */
+static gl_map_t resolved_pointers = NULL;
+
+static bool batch;
+
 const char *argp_program_version; /* initialised in main */
 const char *argp_program_bug_address = PACKAGE_BUGREPORT;
 error_t argp_err_exit_status = FAIL;
 
+enum opts { OPT_BATCH = 256, OPT_MAX };
+
 static const char args_doc[] = N_ ("KEYWORD...");
 static const char apropos_doc[] =
         "\v" N_ ("The --regex option is enabled by default.");
@@ -144,6 +156,8 @@ static struct argp_option options[] = {
              N_ ("define the locale for this search")),
         OPT ("config-file", 'C', N_ ("FILE"),
              N_ ("use this user configuration file")),
+        OPT ("batch", OPT_BATCH, 0,
+             N_ ("read keywords from standard input, one query per line")),
         OPT_HIDDEN ("whatis", 'f'),
         OPT_HIDDEN ("apropos", 'k'),
         OPT_HELP_COMPAT,
@@ -227,6 +241,9 @@ static error_t parse_opt (int key, char *arg, struct argp_state *state)
 			/* helpful override if program name detection fails */
 			am_apropos = true;
 			return 0;
+		case OPT_BATCH:
+			batch = true;
+			return 0;
 		case 'h':
 			argp_state_help (state, state->out_stream,
 			                 ARGP_HELP_STD_HELP &
@@ -237,12 +254,18 @@ static error_t parse_opt (int key, char *arg, struct argp_state *state)
 			num_keywords = state->argc - state->next;
 			return 0;
 		case ARGP_KEY_NO_ARGS:
+			if (batch)
+				return 0;
 			/* Make sure that we have a keyword! */
 			printf (_ ("%s what?\n"), program_name);
 			exit (FAIL);
 		case ARGP_KEY_SUCCESS:
 			if (am_apropos && !exact && !wildcard)
 				regex_opt = true;
+			if (batch && num_keywords)
+				argp_error (state,
+				            _ ("--batch reads keywords from "
+				               "standard input"));
 			return 0;
 	}
 	return ARGP_ERR_UNKNOWN;
@@ -349,22 +372,19 @@ static void use_grep (const char *const *pages, int num_pages, char *manpath,
 	free (whatis_file);
 }
 
-static struct mandata *resolve_pointers (MYDBM_FILE dbf, struct mandata *info,
-                                         const char *page)
+static struct mandata *follow_pointers (MYDBM_FILE dbf,
+                                        const struct mandata *start,
+                                        const char *page)
 {
+	struct mandata *info;
 	int rounds;
 	const char *newpage;
 
-	if (*(info->pointer) == '-' ||
-	    ((!info->name || STREQ (info->name, page)) &&
-	     STREQ (info->pointer, page)))
-		return info;
-
 	/* Now we have to work through pointers. The limit of 10 is fairly
 	 * arbitrary: it's just there to avoid an infinite loop.
 	 */
-	newpage = info->pointer;
-	info = dblookup_exact (dbf, newpage, info->ext, true);
+	newpage = start->pointer;
+	info = dblookup_exact (dbf, newpage, start->ext, true);
 	for (rounds = 0; rounds < 10; rounds++) {
 		struct mandata *newinfo;
 
@@ -382,17 +402,48 @@ static struct mandata *resolve_pointers (MYDBM_FILE dbf, struct mandata *info,
 		info = newinfo;
 	}
 
+	free_mandata_struct (info);
 	if (!quiet)
 		error (0, 0, _ ("warning: %s contains a pointer loop"), page);
 	return NULL;
 }
 
+/* Return the entry that INFO ultimately points to, which is INFO itself
+ * if it is not a pointer, or NULL if that cannot be found.  Broad apropos
+ * searches find many entries pointing to the same page, so results are
+ * remembered in RESOLVED_POINTERS, which owns them.
+ */
+static const struct mandata *resolve_pointers (MYDBM_FILE dbf,
+                                               const struct mandata *info,
+                                               const char *page)
+{
+	const struct mandata *resolved;
+	char *key;
+
+	if (*(info->pointer) == '-' ||
+	    ((!info->name || STREQ (info->name, page)) &&
+	     STREQ (info->pointer, page)))
+		return info;
+
+	key = xasprintf ("%s\t%s", info->pointer, info->ext);
+	if (gl_map_search (resolved_pointers, key,
+	                   (const void **) &resolved)) {
+		debug ("reusing resolution of %s(%s)\n", info->pointer,
+		       info->ext);
+		free (key);
+		return resolved;
+	}
+	resolved = follow_pointers (dbf, info, page);
+	gl_map_put (resolved_pointers, key, resolved);
+	return resolved;
+}
+
 /* fill_in_whatis() is really a ../libdb/db_lookup.c routine but whatis.c
    is the only file that actually requires access to the whatis text... */
 
 /* Take mandata struct (earlier returned from a dblookup()) and return
    the relative whatis */
-static char *get_whatis (struct mandata *info, const char *page)
+static char *get_whatis (const struct mandata *info, const char *page)
 {
 	if (!info)
 		return xstrdup (_ ("(unknown subject)"));
@@ -408,7 +459,7 @@ static char *get_whatis (struct mandata *info, const char *page)
 /* print out any matches found */
 static void display (MYDBM_FILE dbf, struct mandata *info, const char *page)
 {
-	struct mandata *newinfo;
+	const struct mandata *newinfo;
 	char *string, *whatis, *string_conv;
 	const char *page_name;
 	char *key;
@@ -467,8 +518,6 @@ static void display (MYDBM_FILE dbf, struct mandata *info, const char *page)
 out:
 	free (key);
 	free (whatis);
-	if (newinfo != info)
-		free_mandata_struct (newinfo);
 }
 
 /* lookup the page and display the results */
@@ -666,125 +715,105 @@ static void parse_whatis (const char *const *pages, int num_pages,
 	}
 }
 
+/* Like parse_whatis, but for a description that the database shares
+ * between several entries, which only needs to be tested once.
+ * SHARED_MATCHES records which pages each such description matched.
+ */
+static void parse_shared_whatis (gl_map_t shared_matches,
+                                 const char *const *pages, int num_pages,
+                                 const char *whatis, bool *found,
+                                 bool *found_here)
+{
+	bool *matches;
+	int i;
+
+	matches = (bool *) gl_map_get (shared_matches, whatis);
+	if (!matches) {
+		matches = XCALLOC (num_pages, bool);
+		parse_whatis (pages, num_pages, whatis, matches, matches);
+		gl_map_put (shared_matches, whatis, matches);
+	}
+	for (i = 0; i < num_pages; ++i)
+		if (matches[i])
+			found[i] = found_here[i] = true;
+}
+
 /* cjwatson: Optimized functions don't seem to be correct in some
  * circumstances; disabled for now.
  */
 #undef BTREE
 
+/* Does SECTIONS include either the section or extension of this page? */
+static bool section_wanted (const struct db_snapshot *snap, size_t row,
+                            void *data MAYBE_UNUSED)
+{
+	const char *sec = db_snapshot_string (snap, SNAPSHOT_SEC, row);
+	const char *ext = db_snapshot_string (snap, SNAPSHOT_EXT, row);
+	char *const *section;
+
+	for (section = sections; *section; ++section)
+		if (STREQ (*section, sec) || STREQ (*section, ext))
+			return true;
+	return false;
+}
+
 /* scan for the page, print any matches */
 static void do_apropos (MYDBM_FILE dbf, const char *const *pages,
                         int num_pages, bool *found)
 {
-	datum key, cont;
+	struct db_snapshot *snap;
+	size_t *rows, nrows, i;
 	bool *found_here;
 	bool (*combine) (int, const bool *);
-#ifndef BTREE
-	datum nextkey;
-#else  /* BTREE */
-	int end;
-#endif /* !BTREE */
+	gl_map_t shared_matches;
 
 	found_here = XNMALLOC (num_pages, bool);
 	combine = require_all ? all_set : any_set;
+	/* Keyed by address, since the snapshot holds each shared
+	 * description only once.
+	 */
+	shared_matches = gl_map_create_empty (GL_HASH_MAP, NULL, NULL, NULL,
+	                                      plain_free);
 
-#ifndef BTREE
-	key = MYDBM_FIRSTKEY (dbf);
-	while (MYDBM_DPTR (key)) {
-		cont = MYDBM_FETCH (dbf, key);
-#else  /* BTREE */
-	end = man_btree_nextkeydata (dbf, &key, &cont);
-	while (!end) {
-#endif /* !BTREE */
-		char *tab;
-		struct mandata *info = NULL;
-
-		/* bug#4372, NULL pointer dereference in MYDBM_DPTR (cont),
-		 * fix by dassen@wi.leidenuniv.nl (J.H.M.Dassen), thanx Ray.
-		 * cjwatson: In that case, complain and exit, otherwise we
-		 * might loop (bug #95052).
-		 */
-		if (!MYDBM_DPTR (cont)) {
-			debug ("key was %s\n", MYDBM_DPTR (key));
-			fatal (0,
-			       _ ("Database %s corrupted; rebuild with "
-			          "mandb --create"),
-			       dbf->name);
-		}
-
-#pragma GCC diagnostic push
-#if GNUC_PREREQ(10, 0)
-#  pragma GCC diagnostic ignored "-Wanalyzer-use-after-free"
-#endif
-		if (*MYDBM_DPTR (key) == '$')
-			goto nextpage;
-
-		if (*MYDBM_DPTR (cont) == '\t')
-			goto nextpage;
-#pragma GCC diagnostic pop
-
-		/* a real page */
-
-		info = split_content (dbf, MYDBM_DPTR (cont));
-
-		/* If there are sections given, does any of them match
-		 * either the section or extension of this page?
-		 */
-		if (sections) {
-			char *const *section;
-			bool matched = false;
-
-			for (section = sections; *section; ++section) {
-				if (STREQ (*section, info->sec) ||
-				    STREQ (*section, info->ext)) {
-					matched = true;
-					break;
-				}
-			}
-
-			if (!matched)
-				goto nextpage;
-		}
+	/* Read the whole database in one pass first; then only the columns
+	 * we actually test need to be examined for each page.
+	 */
+	snap = db_snapshot_load (dbf);
+	rows = db_snapshot_rows (snap);
+	nrows = snap->count;
+	if (sections)
+		nrows = db_snapshot_filter (snap, rows, nrows, section_wanted,
+		                            NULL);
 
-		tab = strrchr (MYDBM_DPTR (key), '\t');
-		if (tab)
-			*tab = '\0';
+	for (i = 0; i < nrows; ++i) {
+		const char *key = db_snapshot_string (snap, SNAPSHOT_KEY,
+		                                      rows[i]);
 
 		memset (found_here, 0, num_pages * sizeof (*found_here));
-		parse_name (pages, num_pages, MYDBM_DPTR (key), found,
-		            found_here);
-		if (am_apropos) {
-			char *whatis;
-
-			whatis = info->whatis ? xstrdup (info->whatis) : NULL;
-			if (!combine (num_pages, found_here) && whatis)
+		parse_name (pages, num_pages, key, found, found_here);
+		if (am_apropos && !combine (num_pages, found_here)) {
+			const char *whatis = db_snapshot_string (
+			        snap, SNAPSHOT_WHATIS, rows[i]);
+
+			if (snap->shared_whatis[rows[i]])
+				parse_shared_whatis (shared_matches, pages,
+				                     num_pages, whatis, found,
+				                     found_here);
+			else
 				parse_whatis (pages, num_pages, whatis, found,
 				              found_here);
-			free (whatis);
 		}
-		if (combine (num_pages, found_here))
-			display (dbf, info, MYDBM_DPTR (key));
-
-		if (tab)
-			*tab = '\t';
-nextpage:
-#pragma GCC diagnostic push
-#if GNUC_PREREQ(10, 0)
-#  pragma GCC diagnostic ignored "-Wanalyzer-double-free"
-#endif
-#ifndef BTREE
-		nextkey = MYDBM_NEXTKEY (dbf, key);
-		MYDBM_FREE_DPTR (cont);
-		MYDBM_FREE_DPTR (key);
-		key = nextkey;
-#else  /* BTREE */
-		MYDBM_FREE_DPTR (cont);
-		MYDBM_FREE_DPTR (key);
-		end = man_btree_nextkeydata (dbf, &key, &cont);
-#endif /* !BTREE */
-#pragma GCC diagnostic pop
-		free_mandata_struct (info);
+		if (combine (num_pages, found_here)) {
+			struct mandata info;
+
+			db_snapshot_row (snap, rows[i], &info);
+			display (dbf, &info, key);
+		}
 	}
 
+	gl_map_free (shared_matches);
+	free (rows);
+	db_snapshot_free (snap);
 	free (found_here);
 }
 
@@ -805,12 +834,15 @@ static bool search (const char *const *pages, int num_pages)
 
 		debug ("path=%s\n", mp);
 
-		dbf = MYDBM_NEW (database);
-		if (!MYDBM_RDOPEN (dbf) || dbver_rd (dbf)) {
+		dbf = dbcache_open (database);
+		if (!dbf) {
 			use_grep (pages, num_pages, mp, found);
 			goto next;
 		}
 
+		resolved_pointers = new_string_map (
+		        GL_HASH_MAP,
+		        (gl_mapvalue_dispose_fn) free_mandata_struct);
 		if (am_apropos)
 			do_apropos (dbf, pages, num_pages, found);
 		else {
@@ -819,9 +851,10 @@ static bool search (const char *const *pages, int num_pages)
 			else
 				do_whatis (dbf, pages, num_pages, mp, found);
 		}
+		gl_map_free (resolved_pointers);
+		resolved_pointers = NULL;
 
 next:
-		MYDBM_FREE (dbf);
 		free (database);
 		free (catpath);
 	}
@@ -839,6 +872,72 @@ next:
 	return any_found;
 }
 
+/* Look up one set of keywords, returning true if anything was found. */
+static bool query (char **words, int num_words)
+{
+	bool found;
+	int i;
+
+	if (regex_opt) {
+		preg = XNMALLOC (num_words, regex_t);
+		for (i = 0; i < num_words; ++i)
+			xregcomp (&preg[i], words[i],
+			          REG_EXTENDED | REG_NOSUB | REG_ICASE);
+	}
+
+	found = search ((const char **) words, num_words);
+
+	if (regex_opt) {
+		for (i = 0; i < num_words; ++i)
+			regfree (&preg[i]);
+		free (preg);
+		preg = NULL;
+	}
+
+	return found;
+}
+
+/* Read queries from standard input, one per line.  The answers to each
+ * query are followed by an empty line, and flushed at once, so that
+ * callers can use a single process to look up many keywords while
+ * keeping the databases open.
+ */
+static int query_batch (void)
+{
+	char *line = NULL;
+	size_t len = 0;
+	char **words = NULL;
+	size_t words_max = 0;
+	int status = OK;
+
+	while (getline (&line, &len, stdin) != -1) {
+		size_t nwords = 0;
+		char *word;
+
+		for (word = strtok (line, " \t\n"); word;
+		     word = strtok (NULL, " \t\n")) {
+			if (nwords + 1 >= words_max)
+				words = x2nrealloc (words, &words_max,
+				                    sizeof *words);
+			words[nwords++] = word;
+		}
+
+		if (nwords) {
+			gl_set_free (display_seen);
+			display_seen = new_string_set (GL_HASH_SET);
+			if (!query (words, (int) nwords))
+				status = NOT_FOUND;
+		}
+
+		putchar ('\n');
+		fflush (stdout);
+	}
+
+	free (words);
+	free (line);
+	return status;
+}
+
 int main (int argc, char *argv[])
 {
 	char *program_base_name;
@@ -914,24 +1013,12 @@ int main (int argc, char *argv[])
 
 	display_seen = new_string_set (GL_HASH_SET);
 
-	if (regex_opt) {
-		int i;
-		preg = XNMALLOC (num_keywords, regex_t);
-		for (i = 0; i < num_keywords; ++i)
-			xregcomp (&preg[i], keywords[i],
-			          REG_EXTENDED | REG_NOSUB | REG_ICASE);
-	}
-
-	if (!search ((const char **) keywords, num_keywords))
+	if (batch)
+		status = query_batch ();
+	else if (!query (keywords, num_keywords))
 		status = NOT_FOUND;
 
-	if (regex_opt) {
-		int i;
-		for (i = 0; i < num_keywords; ++i)
-			regfree (&preg[i]);
-		free (preg);
-	}
-
+	dbcache_close_all ();
 	gl_set_free (display_seen);
 	free_pathlist (manpathlist);
 	free (manp);
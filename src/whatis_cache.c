@@ -0,0 +1,346 @@
+/*
+ * whatis_cache.c: cache of whatis information, keyed by file identity
+ *
+ * Copyright (C) 2024 Colin Watson.
+ *
+ * This file is part of man-db.
+ *
+ * man-db is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * man-db is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with man-db; if not, write to the Free Software Foundation,
+ * Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ * mandb caches the whatis information it finds in each page's ultimate
+ * source, keyed by the device, inode, modification time, and size of that
+ * file rather than by its name, and keeps a copy of the part of the cache
+ * used by each hierarchy next to that hierarchy's database.  The cache is
+ * a sequence of records, each made of four NUL-terminated fields: the key,
+ * the name of the file, the whatis, and the filters.  The last two start
+ * with '+' if they are present or '-' if not.  A cache written by any
+ * other version of man-db is ignored, since lexgrog's results may differ.
+ */
+
+#ifdef HAVE_CONFIG_H
+#  include "config.h"
+#endif /* HAVE_CONFIG_H */
+
+#include <errno.h>
+#include <fcntl.h>
+#include <inttypes.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <sys/types.h>
+#include <unistd.h>
+
+#include "gl_hash_map.h"
+#include "gl_hash_set.h"
+#include "gl_xmap.h"
+#include "gl_xset.h"
+#include "stat-time.h"
+#include "xalloc.h"
+#include "xvasprintf.h"
+
+#include "manconfig.h"
+
+#include "debug.h"
+#include "glcontainers.h"
+
+#include "whatis_cache.h"
+
+#define WHATIS_CACHE_HEADER "man-db whatis cache 2 " PACKAGE_VERSION "\n"
+
+struct cached_whatis {
+	char *path;
+	char *whatis;
+	char *filters;
+};
+
+static gl_map_t entries; /* key -> struct cached_whatis */
+static gl_set_t tree_keys; /* keys used for the current hierarchy */
+static gl_set_t kept_keys; /* keys carried over from its old cache */
+static bool dirty;
+
+static void cached_whatis_free (const void *value)
+{
+	struct cached_whatis *entry = (struct cached_whatis *) value;
+
+	free (entry->path);
+	free (entry->whatis);
+	free (entry->filters);
+	free (entry);
+}
+
+static char *make_key (const struct stat *st)
+{
+	struct timespec mtime = get_stat_mtime (st);
+
+	return xasprintf ("%" PRIuMAX ":%" PRIuMAX ":%" PRIdMAX
+	                  ".%09ld:%" PRIdMAX,
+	                  (uintmax_t) st->st_dev, (uintmax_t) st->st_ino,
+	                  (intmax_t) mtime.tv_sec, (long) mtime.tv_nsec,
+	                  (intmax_t) st->st_size);
+}
+
+/* Note that KEY (which is consumed) was used for the current hierarchy. */
+static void use_key (char *key)
+{
+	if (gl_set_add (tree_keys, key)) {
+		if (!kept_keys || !gl_set_search (kept_keys, key))
+			dirty = true;
+	} else
+		free (key);
+}
+
+/* Add an entry if there isn't one already, taking ownership of PATH,
+ * WHATIS, and FILTERS.
+ */
+static void add_entry (const char *key, char *path, char *whatis,
+                       char *filters)
+{
+	if (!gl_map_get (entries, key)) {
+		struct cached_whatis *entry = XMALLOC (struct cached_whatis);
+
+		entry->path = path;
+		entry->whatis = whatis;
+		entry->filters = filters;
+		gl_map_put (entries, xstrdup (key), entry);
+	} else {
+		free (path);
+		free (whatis);
+		free (filters);
+	}
+}
+
+char *whatis_cache_name (const char *dbdir)
+{
+	return xasprintf ("%s/index.whatis", dbdir);
+}
+
+/* Convert a field read from the cache back to a string or NULL. */
+static char *read_optional (const char *field)
+{
+	return *field == '+' ? xstrdup (field + 1) : NULL;
+}
+
+void whatis_cache_load (const char *dbdir, bool keep)
+{
+	char *name;
+	FILE *file;
+	char *line = NULL;
+	size_t line_len = 0;
+	char *fields[4] = {NULL, NULL, NULL, NULL};
+	size_t fields_len[4] = {0, 0, 0, 0};
+	size_t count = 0;
+
+	if (!entries)
+		entries = new_string_map (GL_HASH_MAP, cached_whatis_free);
+	if (tree_keys)
+		gl_set_free (tree_keys);
+	tree_keys = new_string_set (GL_HASH_SET);
+	if (kept_keys)
+		gl_set_free (kept_keys);
+	kept_keys = keep ? new_string_set (GL_HASH_SET) : NULL;
+	dirty = false;
+
+	name = whatis_cache_name (dbdir);
+	file = fopen (name, "r");
+	if (!file) {
+		debug ("no whatis cache %s\n", name);
+		free (name);
+		return;
+	}
+
+	if (getline (&line, &line_len, file) < 0 ||
+	    !STREQ (line, WHATIS_CACHE_HEADER)) {
+		debug ("ignoring whatis cache %s from another version\n",
+		       name);
+		goto out;
+	}
+
+	for (;;) {
+		int i;
+
+		for (i = 0; i < 4; ++i)
+			if (getdelim (&fields[i], &fields_len[i], '\0',
+			              file) < 0)
+				goto out;
+		if (*fields[1] != '/')
+			goto out;
+		if (*fields[2] != '+' && *fields[2] != '-')
+			goto out;
+		if (*fields[3] != '+' && *fields[3] != '-')
+			goto out;
+		add_entry (fields[0], xstrdup (fields[1]),
+		           read_optional (fields[2]),
+		           read_optional (fields[3]));
+		if (keep)
+			gl_set_add (kept_keys, xstrdup (fields[0]));
+		++count;
+	}
+
+out:
+	debug ("loaded %zu entries from whatis cache %s\n", count, name);
+	free (fields[3]);
+	free (fields[2]);
+	free (fields[1]);
+	free (fields[0]);
+	free (line);
+	fclose (file);
+	free (name);
+}
+
+bool whatis_cache_lookup (const struct stat *st, char **whatis,
+                          char **filters)
+{
+	const struct cached_whatis *entry;
+	char *key;
+
+	if (!entries)
+		return false;
+
+	key = make_key (st);
+	entry = gl_map_get (entries, key);
+	if (!entry) {
+		free (key);
+		return false;
+	}
+	*whatis = entry->whatis ? xstrdup (entry->whatis) : NULL;
+	*filters = entry->filters ? xstrdup (entry->filters) : NULL;
+	use_key (key);
+	return true;
+}
+
+void whatis_cache_add (const char *path, const struct stat *st,
+                       const char *whatis, const char *filters)
+{
+	char *key;
+
+	if (!entries)
+		return;
+
+	key = make_key (st);
+	add_entry (key, xstrdup (path), whatis ? xstrdup (whatis) : NULL,
+	           filters ? xstrdup (filters) : NULL);
+	use_key (key);
+}
+
+static void write_optional (FILE *file, const char *value)
+{
+	if (value) {
+		putc ('+', file);
+		fputs (value, file);
+	} else
+		putc ('-', file);
+	putc ('\0', file);
+}
+
+static void write_entry (FILE *file, const char *key,
+                         const struct cached_whatis *entry)
+{
+	fputs (key, file);
+	putc ('\0', file);
+	fputs (entry->path, file);
+	putc ('\0', file);
+	write_optional (file, entry->whatis);
+	write_optional (file, entry->filters);
+}
+
+/* Is the file that ENTRY was cached for still there, and unchanged? */
+static bool entry_current (const char *key,
+                           const struct cached_whatis *entry)
+{
+	struct stat st;
+	char *current_key;
+	bool ret;
+
+	if (stat (entry->path, &st) < 0)
+		return false;
+	current_key = make_key (&st);
+	ret = STREQ (current_key, key);
+	free (current_key);
+	return ret;
+}
+
+bool whatis_cache_save (const char *dbdir)
+{
+	char *name, *tmpname;
+	int fd;
+	FILE *file;
+	gl_set_iterator_t iter;
+	const char *key;
+	size_t count = 0;
+	bool ok;
+
+	if (!tree_keys || !dirty)
+		return false;
+
+	name = whatis_cache_name (dbdir);
+	tmpname = xasprintf ("%s/%d.whatis", dbdir, getpid ());
+	fd = open (tmpname, O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, DBMODE);
+	file = fd < 0 ? NULL : fdopen (fd, "w");
+	if (!file) {
+		if (fd >= 0)
+			close (fd);
+		debug_error ("can't write whatis cache %s", tmpname);
+		free (tmpname);
+		free (name);
+		return false;
+	}
+
+	fputs (WHATIS_CACHE_HEADER, file);
+	iter = gl_set_iterator (tree_keys);
+	while (gl_set_iterator_next (&iter, (const void **) &key)) {
+		write_entry (file, key, gl_map_get (entries, key));
+		++count;
+	}
+	gl_set_iterator_free (&iter);
+
+	/* Entries we didn't use this time are for pages in directories
+	 * that we didn't look at.  Keep those whose pages still exist.
+	 */
+	if (kept_keys) {
+		iter = gl_set_iterator (kept_keys);
+		while (gl_set_iterator_next (&iter, (const void **) &key)) {
+			const struct cached_whatis *entry =
+			        gl_map_get (entries, key);
+
+			if (gl_set_search (tree_keys, key) ||
+			    !entry_current (key, entry))
+				continue;
+			write_entry (file, key, entry);
+			++count;
+		}
+		gl_set_iterator_free (&iter);
+	}
+
+	ok = !ferror (file);
+	if (fclose (file) != 0)
+		ok = false;
+	if (ok && rename (tmpname, name) < 0)
+		ok = false;
+	if (ok) {
+		debug ("wrote %zu entries to whatis cache %s\n", count,
+		       name);
+		dirty = false;
+	} else {
+		debug ("failed to write whatis cache %s\n", name);
+		unlink (tmpname);
+	}
+
+	free (tmpname);
+	free (name);
+	return ok;
+}
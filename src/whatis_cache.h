@@ -0,0 +1,56 @@
+/*
+ * whatis_cache.h: interface to the persistent cache of whatis information
+ *
+ * Copyright (C) 2024 Colin Watson.
+ *
+ * This file is part of man-db.
+ *
+ * man-db is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * man-db is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with man-db; if not, write to the Free Software Foundation,
+ * Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ */
+
+#ifndef MAN_WHATIS_CACHE_H
+#define MAN_WHATIS_CACHE_H
+
+#include <stdbool.h>
+#include <sys/stat.h>
+
+/* Return the file name of the whatis cache for the database in DBDIR. */
+extern char *whatis_cache_name (const char *dbdir);
+
+/* Start work on the hierarchy whose database is in DBDIR, loading its
+ * whatis cache.  Entries loaded from caches for other hierarchies remain
+ * available.  If KEEP is true, entries from this cache that are not used
+ * in the meantime are written back out by whatis_cache_save as long as
+ * their files still exist unchanged.
+ */
+extern void whatis_cache_load (const char *dbdir, bool keep);
+
+/* Look up the whatis information for the file described by ST.  If it is
+ * known, set *WHATIS and *FILTERS to newly-allocated copies (either of
+ * which may be NULL) and return true.
+ */
+extern bool whatis_cache_lookup (const struct stat *st, char **whatis,
+                                 char **filters);
+
+/* Remember the whatis information for PATH, which is described by ST. */
+extern void whatis_cache_add (const char *path, const struct stat *st,
+                              const char *whatis, const char *filters);
+
+/* Write out the whatis cache for the hierarchy whose database is in DBDIR,
+ * if it has changed.  Returns true if it was written.
+ */
+extern bool whatis_cache_save (const char *dbdir);
+
+#endif /* MAN_WHATIS_CACHE_H */